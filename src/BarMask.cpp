@@ -0,0 +1,343 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include "BarMask.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Create a complete bar mask image
+ *
+ * \param mask (out) The bar mask image
+ * \param size Size of the bar mask
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ *
+ * \return False, if the parameters are invalid or the image could not be
+ *  allocated.
+ */
+bool BarMask::create(QImage& mask, const QSize& size, int stripWidth, int nrFrames)
+{
+	if (size.isEmpty() || stripWidth <= 0 || nrFrames <= 0) return false;
+
+	mask = QImage(size, QImage::Format_Mono);
+	if (mask.isNull()) return false;
+
+	unsigned char *bits = mask.bits();
+	int bytesPerLine = mask.bytesPerLine();
+
+	fillRow(bits, bytesPerLine, size.width(), stripWidth, nrFrames);
+	copyRows(bits, bytesPerLine, bits, 1, size.height());
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Fill a plain 1-bpp buffer with the bar mask
+ *
+ * This is the plain C++ counterpart of create(). The buffer is packed most
+ * significant bit first, as QImage::Format_Mono.
+ *
+ * \param mask The buffer to fill
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ */
+void BarMask::fill(const FrameBuffer& mask, int stripWidth, int nrFrames)
+{
+	if (mask.height <= 0 || stripWidth <= 0 || nrFrames <= 0) return;
+
+	fillRow(mask.bits, mask.bytesPerLine, mask.width, stripWidth, nrFrames);
+	copyRows(mask.bits, mask.bytesPerLine, mask.bits, 1, mask.height);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Get parameters from bar mask image
+ *
+ * This method reconstruct number of frames and pixel width per frame from
+ * a bar mask image. Please note that this works with pixel indices on a
+ * monochrome image only. The 0 index is considered to be the opaque bars
+ * (usually black), while the 1 indices are the transparent bars (usually
+ * transparent or white).
+ *
+ * \param img Bar mask image
+ * \param nrFrames (out) Number of frame images
+ * \param stripWidth (out) Strip width in pixels
+ * \param validate If true, all rows are checked against the bar pattern,
+ *  not just the first white and black strip of the first row.
+ *
+ * \return NoError if reconstruction of parameters was successful and the
+ *  reason of failure otherwise, see errorString(). The latter case indicates
+ *  that the provided image is not a valid bar mask image.
+ */
+BarMask::DecodeError BarMask::decode(const QImage& img, unsigned int& nrFrames, unsigned int& stripWidth, bool validate)
+{
+	nrFrames = 0;
+	stripWidth = 0;
+
+	/* check format */
+	if (img.format() != QImage::Format_Mono) return InvalidFormat;
+
+	/* Format_Mono has index 1 in bit 1, no matter what the color table
+	 * says, so we may work on the raw bits.
+	 */
+	FrameBuffer mask((unsigned char*) img.constBits(), img.width(), img.height(), img.bytesPerLine());
+	return decode(mask, nrFrames, stripWidth, validate);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Get parameters from a plain 1-bpp bar mask buffer
+ *
+ * See decode(const QImage&, unsigned int&, unsigned int&, bool), the buffer
+ * is packed most significant bit first. The strips of the first row are
+ * measured 64 bits at a time, see runLength().
+ */
+BarMask::DecodeError BarMask::decode(const FrameBuffer& mask, unsigned int& nrFrames, unsigned int& stripWidth, bool validate)
+{
+	nrFrames = 0;
+	stripWidth = 0;
+
+	if (mask.width <= 0 || mask.height <= 0) return UnexpectedContents;
+
+	const unsigned char *line = mask.scanLine(0);
+	unsigned int width = mask.width;
+
+	/* we start with a white strip, followed by the black strips */
+	if (!(line[0] & 0x80)) return UnexpectedContents;
+
+	/* We examine the first row always. The width of the white strip is the
+	 * stripwidth
+	 */
+	stripWidth = runLength(line, 0, width, true);
+
+	if (stripWidth >= width) return UnexpectedStripWidth;
+	if (stripWidth == 0) return UnsupportedStripWidth;
+
+	/* The number of frame images is the width of the black strip, divided by
+	 * the strip width, plus one.
+	 */
+	nrFrames = stripWidth + runLength(line, stripWidth, width, false);
+
+	if (nrFrames >= width) return UnexpectedNrFrames;
+
+	/* check */
+
+	if (nrFrames == 0) return UnsupportedNrFrames;
+	if (nrFrames % stripWidth != 0) return InvalidNrFrames;
+
+	nrFrames /= stripWidth;
+
+	if (validate && !matches(mask, stripWidth, nrFrames)) return InconsistentContents;
+
+	return NoError;
+}
+
+//----------------------------------------------------------------------
+
+/* Count the bits equal to value in a packed scanline of width bits, starting
+ * at bit from. We load the next 64 bits as one big endian word, turn the
+ * bits we look for into zeros and count the leading zeros.
+ */
+unsigned int BarMask::runLength(const unsigned char* line, unsigned int from, unsigned int width, bool value)
+{
+	unsigned int lineBytes = (width + 7) / 8;
+	unsigned int pos = from;
+
+	while (pos < width) {
+		unsigned int byte = pos >> 3;
+		unsigned int shift = pos & 7;
+
+		quint64 word = 0;
+		for ( unsigned int i=0 ; i<8 ; i++ ) {
+			word <<= 8;
+			if (byte + i < lineBytes) word |= line[byte + i];
+		}
+		if (value) word = ~word;
+		word <<= shift;
+
+		/* only 64 - shift bits of the word are from the line */
+		unsigned int valid = 64 - shift;
+		unsigned int run = word ? countLeadingZeros(word) : 64;
+		if (run > valid) run = valid;
+
+		pos += run;
+		if (run < valid) break;
+	}
+
+	return qMin(pos, width) - from;
+}
+
+//----------------------------------------------------------------------
+
+/* Number of leading zero bits of a non-zero word. */
+unsigned int BarMask::countLeadingZeros(quint64 word)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(word);
+#else
+	return countLeadingZerosPortable(word);
+#endif
+}
+
+//----------------------------------------------------------------------
+
+/* The same without compiler support, by binary search. It is compiled
+ * everywhere, so the tests can compare it with the builtin.
+ */
+unsigned int BarMask::countLeadingZerosPortable(quint64 word)
+{
+	unsigned int n = 0;
+	if (!(word & Q_UINT64_C(0xffffffff00000000))) { n += 32; word <<= 32; }
+	if (!(word & Q_UINT64_C(0xffff000000000000))) { n += 16; word <<= 16; }
+	if (!(word & Q_UINT64_C(0xff00000000000000))) { n += 8; word <<= 8; }
+	if (!(word & Q_UINT64_C(0xf000000000000000))) { n += 4; word <<= 4; }
+	if (!(word & Q_UINT64_C(0xc000000000000000))) { n += 2; word <<= 2; }
+	if (!(word & Q_UINT64_C(0x8000000000000000))) { n += 1; }
+	return n;
+}
+
+//----------------------------------------------------------------------
+
+/* Check that every row of mask is the bar pattern of the given parameters,
+ * ignoring the padding bits of each scanline.
+ */
+bool BarMask::matches(const FrameBuffer& mask, int stripWidth, int nrFrames)
+{
+	int lineBytes = (mask.width + 7) / 8;
+	int fullBytes = mask.width / 8;
+	unsigned char lastMask = 0xff << (8 - (mask.width & 7));
+
+	std::vector< unsigned char > expected(lineBytes);
+	fillRow(&expected[0], lineBytes, mask.width, stripWidth, nrFrames);
+
+	for ( int row=0 ; row<mask.height ; row++ ) {
+		const unsigned char *line = mask.scanLine(row);
+		if (memcmp(line, &expected[0], fullBytes) != 0) return false;
+		if (fullBytes < lineBytes && ((line[fullBytes] ^ expected[fullBytes]) & lastMask)) return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Describe why decode() failed
+ *
+ * The descriptions are marked for translation in the context "BarMask",
+ * translate them with QCoreApplication::translate().
+ */
+const char* BarMask::errorString(DecodeError error)
+{
+	switch (error) {
+	case NoError: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is valid.");
+	case InvalidFormat: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of invalid format.");
+	case UnexpectedContents: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of unexpected contents.");
+	case UnexpectedStripWidth: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of unexpected size (stripWidth).");
+	case UnsupportedStripWidth: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of unsupported contents (stripWidth).");
+	case UnexpectedNrFrames: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of unexpected size (nrFrames).");
+	case UnsupportedNrFrames: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of unsupported contents (nrFrames).");
+	case InvalidNrFrames: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of invalid contents (nrFrames).");
+	case InconsistentContents: return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is of inconsistent contents (not all rows match the bars).");
+	}
+
+	return QT_TRANSLATE_NOOP("BarMask", "The bar mask image is invalid.");
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Fill one packed scanline of the bar mask
+ *
+ * The scanline is written strip by strip, each strip as a run of whole
+ * bytes plus the partial bytes at its ends. Padding bits beyond width are
+ * cleared.
+ *
+ * \param line The scanline
+ * \param bytesPerLine Bytes of the scanline including padding
+ * \param width Width of the bar mask in pixels
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ * \param offset Shift of the mask in pixels, the columns left of it are
+ *  cleared
+ */
+void BarMask::fillRow(unsigned char* line, int bytesPerLine, int width, int stripWidth, int nrFrames, int offset)
+{
+	memset(line, 0, bytesPerLine);
+
+	int period = stripWidth * nrFrames;
+	for ( int col=offset ; col<width ; col+=period )
+		setBits(line, col, qMin(col + stripWidth, width), true);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Copy a scanline to the rows [rowBegin, rowEnd)
+ *
+ * \param bits Pixel buffer of the bar mask
+ * \param bytesPerLine Bytes per line of the bar mask
+ * \param line The scanline to copy, bytesPerLine bytes
+ * \param rowBegin First row to write
+ * \param rowEnd One past the last row to write
+ */
+void BarMask::copyRows(
+	unsigned char* bits,
+	int bytesPerLine,
+	const unsigned char* line,
+	int rowBegin,
+	int rowEnd)
+{
+	for ( int row=rowBegin ; row<rowEnd ; row++ )
+		memcpy(bits + (size_t) row * bytesPerLine, line, bytesPerLine);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set or clear the bits [from, to) of a packed scanline
+ *
+ * Bits are counted most significant bit first, as in QImage::Format_Mono.
+ */
+void BarMask::setBits(unsigned char* line, int from, int to, bool value)
+{
+	if (from >= to) return;
+
+	int firstByte = from >> 3;
+	int lastByte = (to - 1) >> 3;
+	unsigned char firstMask = 0xff >> (from & 7);
+	unsigned char lastMask = 0xff << (7 - ((to - 1) & 7));
+
+	if (firstByte == lastByte) {
+		unsigned char m = firstMask & lastMask;
+		if (value) line[firstByte] |= m;
+		else line[firstByte] &= ~m;
+		return;
+	}
+
+	if (value) {
+		line[firstByte] |= firstMask;
+		line[lastByte] |= lastMask;
+	} else {
+		line[firstByte] &= ~firstMask;
+		line[lastByte] &= ~lastMask;
+	}
+	if (lastByte - firstByte > 1)
+		memset(line + firstByte + 1, value ? 0xff : 0x00, lastByte - firstByte - 1);
+}
@@ -0,0 +1,72 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BARMASK_H
+#define _BARMASK_H
+
+#include <QImage>
+
+#include "FrameBuffer.h"
+
+/*! \brief Generates the bar mask image
+ *
+ * The bar mask is a QImage::Format_Mono image, most significant bit first.
+ * Index 1 marks the transparent strips, that is the strips of the first
+ * frame, index 0 the opaque ones. All rows of the mask are the same, and
+ * every row is periodic with period stripWidth * nrFrames. Hence, we build
+ * one packed scanline with byte writes and copy it to all other rows.
+ */
+class BarMask
+{
+public:
+	/*! Reasons why decode() failed */
+	enum DecodeError {
+		NoError = 0,
+		InvalidFormat,
+		UnexpectedContents,
+		UnexpectedStripWidth,
+		UnsupportedStripWidth,
+		UnexpectedNrFrames,
+		UnsupportedNrFrames,
+		InvalidNrFrames,
+		InconsistentContents
+	};
+
+	/* documented in source code */
+	static bool create(QImage&, const QSize&, int, int);
+	static void fill(const FrameBuffer&, int, int);
+
+	static DecodeError decode(const QImage&, unsigned int&, unsigned int&, bool = false);
+	static DecodeError decode(const FrameBuffer&, unsigned int&, unsigned int&, bool = false);
+	static const char* errorString(DecodeError);
+
+	static void fillRow(unsigned char*, int, int, int, int, int = 0);
+	static void copyRows(unsigned char*, int, const unsigned char*, int, int);
+
+private:
+	friend class Tests;
+
+	static void setBits(unsigned char*, int, int, bool);
+	static unsigned int runLength(const unsigned char*, unsigned int, unsigned int, bool);
+	static unsigned int countLeadingZeros(quint64);
+	static unsigned int countLeadingZerosPortable(quint64);
+	static bool matches(const FrameBuffer&, int, int);
+};
+
+#endif // _BARMASK_H
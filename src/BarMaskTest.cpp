@@ -0,0 +1,213 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+
+#include "BarMask.h"
+#include "Tests.h"
+
+//----------------------------------------------------------------------
+
+/* The bar mask as animbar drew it before BarMask existed, one pixel at a
+ * time.
+ */
+static QImage referenceMask(const QSize& size, int stripWidth, int nrFrames)
+{
+	QImage mask(size, QImage::Format_Mono);
+	for ( int col=0 ; col<size.width() ; )
+		for ( int i=0 ; i<nrFrames ; i++ )
+			for ( int j=0 ; j<stripWidth && col<size.width() ; j++, col++ )
+				for ( int row=0 ; row<size.height() ; row++ )
+					mask.setPixel(col, row, (i == 0) ? 1 : 0);
+
+	return mask;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compare BarMask::create() and BarMask::fill() with the per-pixel
+ *  reference
+ *
+ * Widths around byte and word boundaries are combined with strip widths
+ * and frame counts, so strips start and end at every bit of a byte. Only
+ * the pixels are compared, the padding bits of the reference are
+ * undefined.
+ */
+int Tests::barMask()
+{
+	static const int widths[] = {1, 7, 8, 9, 15, 31, 32, 33, 63, 64, 65, 100, 257};
+	static const int stripWidths[] = {1, 2, 3, 5, 7, 8, 9, 16, 17, 40};
+	const int height = 3;
+
+	int failures = 0;
+
+	for ( unsigned int w=0 ; w<sizeof(widths) / sizeof(widths[0]) ; w++ )
+		for ( unsigned int s=0 ; s<sizeof(stripWidths) / sizeof(stripWidths[0]) ; s++ )
+			for ( int nrFrames=1 ; nrFrames<=6 ; nrFrames++ ) {
+				int width = widths[w];
+				int stripWidth = stripWidths[s];
+				QSize size(width, height);
+
+				QImage reference = referenceMask(size, stripWidth, nrFrames);
+
+				QImage mask;
+				bool ok = BarMask::create(mask, size, stripWidth, nrFrames);
+				for ( int row=0 ; ok && row<height ; row++ )
+					for ( int col=0 ; ok && col<width ; col++ )
+						ok = (mask.pixelIndex(col, row) == reference.pixelIndex(col, row));
+
+				if (!ok) {
+					std::cerr << "BarMask::create differs from the reference for width " << width
+						<< ", strip width " << stripWidth << ", " << nrFrames << " frames." << std::endl;
+					failures++;
+				}
+
+				int bytesPerLine = (width + 7) / 8;
+				std::vector< unsigned char > bits((size_t) bytesPerLine * height);
+				BarMask::fill(FrameBuffer(&bits[0], width, height, bytesPerLine), stripWidth, nrFrames);
+
+				ok = true;
+				for ( int row=0 ; ok && row<height ; row++ )
+					for ( int col=0 ; ok && col<width ; col++ ) {
+						int index = (bits[(size_t) row * bytesPerLine + (col >> 3)] >> (7 - (col & 7))) & 1;
+						ok = (index == reference.pixelIndex(col, row));
+					}
+
+				if (!ok) {
+					std::cerr << "BarMask::fill differs from the reference for width " << width
+						<< ", strip width " << stripWidth << ", " << nrFrames << " frames." << std::endl;
+					failures++;
+				}
+			}
+
+	return failures;
+}
+
+//----------------------------------------------------------------------
+
+/* How animbar read the parameters of a bar mask before BarMask existed,
+ * one pixel at a time. Unlike the original, the column is checked before
+ * the pixel is read.
+ */
+static bool referenceDecode(const QImage& img, unsigned int& nrFrames, unsigned int& stripWidth)
+{
+	nrFrames = 0;
+	stripWidth = 0;
+
+	if (img.format() != QImage::Format_Mono) return false;
+	if (img.pixelIndex(0, 0) != 1) return false;
+
+	unsigned int width = img.width();
+	while (stripWidth < width && img.pixelIndex(stripWidth, 0) == 1) stripWidth++;
+	if (stripWidth >= width || stripWidth == 0) return false;
+
+	nrFrames = stripWidth;
+	while (nrFrames < width && img.pixelIndex(nrFrames, 0) == 0) nrFrames++;
+	if (nrFrames >= width || nrFrames == 0 || nrFrames % stripWidth != 0) return false;
+
+	nrFrames /= stripWidth;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/* A pseudo random number, the same on every platform. */
+static unsigned int nextRandom(unsigned int& seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compare BarMask::decode() with the per-pixel reference
+ *
+ * Random widths, most of them not a multiple of 64, get valid bar masks,
+ * valid ones with a few flipped bits and plain garbage. The padding bits
+ * past the width are garbage in all of them. The portable bit count that
+ * decode() falls back to without GCC is compared with a bit loop.
+ */
+int Tests::barMaskDecode()
+{
+	const int nrMasks = 3000;
+	const int height = 2;
+
+	int failures = 0;
+	unsigned int seed = 2010;
+
+	for ( int m=0 ; m<nrMasks ; m++ ) {
+		int width = 1 + nextRandom(seed) % 600;
+		QImage mask;
+
+		int kind = m % 3;
+		if (kind == 2) {
+			mask = QImage(width, height, QImage::Format_Mono);
+			for ( int row=0 ; row<height ; row++ )
+				for ( int i=0 ; i<mask.bytesPerLine() ; i++ ) mask.scanLine(row)[i] = (uchar) nextRandom(seed);
+		} else {
+			int stripWidth = 1 + nextRandom(seed) % (m % 2 ? 8 : 100);
+			int nrFrames = 1 + nextRandom(seed) % 12;
+			BarMask::create(mask, QSize(width, height), stripWidth, nrFrames);
+
+			/* flip a few bits of the first row */
+			if (kind == 1)
+				for ( int i=nextRandom(seed) % 4 ; i>=0 ; i-- ) {
+					int col = nextRandom(seed) % width;
+					mask.scanLine(0)[col >> 3] ^= 0x80 >> (col & 7);
+				}
+		}
+
+		/* garbage past the width */
+		int padding = mask.bytesPerLine() * 8 - width;
+		for ( int row=0 ; row<height ; row++ )
+			for ( int col=width ; col<width + padding ; col++ )
+				if (nextRandom(seed) & 1) mask.scanLine(row)[col >> 3] ^= 0x80 >> (col & 7);
+
+		unsigned int nrFrames, stripWidth, referenceNrFrames, referenceStripWidth;
+		bool ok = (BarMask::decode(mask, nrFrames, stripWidth) == BarMask::NoError);
+		bool referenceOk = referenceDecode(mask, referenceNrFrames, referenceStripWidth);
+
+		if (ok != referenceOk || (ok && (nrFrames != referenceNrFrames || stripWidth != referenceStripWidth))) {
+			std::cerr << "BarMask::decode differs from the reference for a mask of width " << width
+				<< ": " << (ok ? "" : "not ") << "decoded " << nrFrames << " frames, strip width " << stripWidth
+				<< ", expected " << (referenceOk ? "" : "not ") << "decoded " << referenceNrFrames
+				<< " frames, strip width " << referenceStripWidth << "." << std::endl;
+			failures++;
+		}
+	}
+
+	for ( int i=0 ; i<nrMasks ; i++ ) {
+		/* a random number of leading zeros, then random bits */
+		quint64 word = ((quint64) nextRandom(seed) << 48) ^ ((quint64) nextRandom(seed) << 32) ^
+			((quint64) nextRandom(seed) << 16) ^ nextRandom(seed) ^ nextRandom(seed);
+		word = (word >> (i % 64)) | 1;
+
+		unsigned int reference = 0;
+		while (!(word & (Q_UINT64_C(0x8000000000000000) >> reference))) reference++;
+
+		if (BarMask::countLeadingZeros(word) != reference || BarMask::countLeadingZerosPortable(word) != reference) {
+			std::cerr << "BarMask counts the leading zeros of a word wrong, expected " << reference << "." << std::endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
@@ -0,0 +1,115 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Base64Device.h"
+
+static const char base64Alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+//----------------------------------------------------------------------
+
+Base64Device::Base64Device(QIODevice *target) :
+	m_target(target),
+	m_nrPending(0),
+	m_chunkSize(0)
+{
+}
+
+//----------------------------------------------------------------------
+
+Base64Device::~Base64Device()
+{
+	close();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write the remaining bytes including padding and close
+ *
+ * The target device stays open.
+ */
+void Base64Device::close()
+{
+	if (!isOpen()) return;
+
+	encode(NULL, 0, true);
+	QIODevice::close();
+}
+
+//----------------------------------------------------------------------
+
+qint64 Base64Device::readData(char*, qint64)
+{
+	return -1;
+}
+
+//----------------------------------------------------------------------
+
+qint64 Base64Device::writeData(const char* data, qint64 len)
+{
+	if (!encode((const unsigned char*) data, len, false)) return -1;
+	return len;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Encode data and pass complete chunks on to the target device
+ *
+ * \param data Bytes to encode
+ * \param len Number of bytes
+ * \param final If true, the pending bytes are encoded with padding and
+ *  the output buffer is flushed.
+ *
+ * \return False, if writing to the target device failed.
+ */
+bool Base64Device::encode(const unsigned char* data, qint64 len, bool final)
+{
+	qint64 pos = 0;
+
+	while (pos < len || final) {
+		/* collect a group of three bytes */
+		while (m_nrPending < 3 && pos < len) m_pending[m_nrPending++] = data[pos++];
+		if (m_nrPending < 3 && !final) break;
+
+		if (m_nrPending > 0) {
+			unsigned char b0 = m_pending[0];
+			unsigned char b1 = (m_nrPending > 1) ? m_pending[1] : 0;
+			unsigned char b2 = (m_nrPending > 2) ? m_pending[2] : 0;
+
+			char *out = m_chunk + m_chunkSize;
+			out[0] = base64Alphabet[b0 >> 2];
+			out[1] = base64Alphabet[((b0 & 0x03) << 4) | (b1 >> 4)];
+			out[2] = (m_nrPending > 1) ? base64Alphabet[((b1 & 0x0f) << 2) | (b2 >> 6)] : '=';
+			out[3] = (m_nrPending > 2) ? base64Alphabet[b2 & 0x3f] : '=';
+			m_chunkSize += 4;
+			m_nrPending = 0;
+		}
+
+		if (final || m_chunkSize + 4 > (int) sizeof(m_chunk)) {
+			if (m_chunkSize > 0 && m_target->write(m_chunk, m_chunkSize) != m_chunkSize) {
+				m_chunkSize = 0;
+				return false;
+			}
+			m_chunkSize = 0;
+			if (final && pos >= len) break;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,59 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BASE64DEVICE_H
+#define _BASE64DEVICE_H
+
+#include <QIODevice>
+
+/*! \brief A write-only device that base64 encodes to another device
+ *
+ * Everything written to this device is encoded on the fly and passed on to
+ * the target device in small chunks, so we never hold more than a few
+ * kilobytes of encoded data. The padding is written by close().
+ */
+class Base64Device : public QIODevice
+{
+public:
+	Base64Device(QIODevice *target);
+	~Base64Device();
+
+	/* documented in source code */
+	bool isSequential() const { return true; }
+	void close();
+
+protected:
+	qint64 readData(char*, qint64);
+	qint64 writeData(const char*, qint64);
+
+private:
+	bool encode(const unsigned char*, qint64, bool);
+
+	QIODevice *m_target;
+
+	/* input bytes that did not fill a complete group of three yet */
+	unsigned char m_pending[3];
+	int m_nrPending;
+
+	/* the output buffer */
+	char m_chunk[4096];
+	int m_chunkSize;
+};
+
+#endif // _BASE64DEVICE_H
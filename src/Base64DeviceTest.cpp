@@ -0,0 +1,75 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include <QBuffer>
+
+#include "Base64Device.h"
+#include "Tests.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Compare Base64Device with QByteArray::toBase64()
+ *
+ * Data of every length modulo three, around the size of the output buffer
+ * and larger than it are written in chunks of different sizes, so groups
+ * of three bytes are split across writes and the buffer is flushed at
+ * every possible point.
+ */
+int Tests::base64Device()
+{
+	static const int lengths[] = {0, 1, 2, 3, 4, 5, 3071, 3072, 3073, 10000, 100003};
+	static const int chunkSizes[] = {1, 2, 3, 7, 4096, 100000};
+
+	int failures = 0;
+
+	for ( unsigned int l=0 ; l<sizeof(lengths) / sizeof(lengths[0]) ; l++ ) {
+		QByteArray data(lengths[l], 0);
+		unsigned int seed = 12345;
+		for ( int i=0 ; i<data.size() ; i++ ) {
+			seed = seed * 1103515245 + 12345;
+			data[i] = (char) (seed >> 16);
+		}
+
+		QByteArray expected = data.toBase64();
+
+		for ( unsigned int c=0 ; c<sizeof(chunkSizes) / sizeof(chunkSizes[0]) ; c++ ) {
+			QBuffer buffer;
+			buffer.open(QIODevice::WriteOnly);
+
+			Base64Device base64(&buffer);
+			base64.open(QIODevice::WriteOnly);
+			bool ok = true;
+			for ( int pos=0 ; ok && pos<data.size() ; pos+=chunkSizes[c] ) {
+				int len = qMin(chunkSizes[c], data.size() - pos);
+				ok = (base64.write(data.constData() + pos, len) == len);
+			}
+			base64.close();
+
+			if (!ok || buffer.data() != expected) {
+				std::cerr << "Base64Device differs from QByteArray::toBase64 for " << data.size()
+					<< " bytes written in chunks of " << chunkSizes[c] << " bytes." << std::endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
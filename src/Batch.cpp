@@ -0,0 +1,433 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QElapsedTimer>
+
+#include "animbar.h"
+#include "Batch.h"
+#include "BarMask.h"
+#include "Composer.h"
+#include "SvgWriter.h"
+#include "FrameStore.h"
+#include "ImageLoader.h"
+#include "TiffWriter.h"
+
+//----------------------------------------------------------------------
+
+Batch::Batch() :
+	m_stripWidth(3),
+	m_threadCount(0),
+	m_duration(-1.),
+	m_compact(false),
+	m_framesOnDisk(false),
+	m_stream(false),
+	m_bandHeight(64),
+	m_timings(false),
+	m_compression(PngWriter::Default),
+	m_help(false)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Check if the command line asks for batch mode
+ *
+ * \param arguments The command line arguments including the program name
+ *
+ * \return True, if there is any option, that is an argument starting with
+ *  "--".
+ */
+bool Batch::isBatch(const QStringList& arguments)
+{
+	for ( int i=1 ; i<arguments.size() ; i++ )
+		if (arguments[i].startsWith("--")) return true;
+
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+QString Batch::usage()
+{
+	return QString(
+		"Usage: %1 --frames FILE... [OPTION]...\n"
+		"  or:  %1 --validate-mask FILE...\n"
+		"Compute a bar animation from the frame images FILE... without user interface,\n"
+		"or check that the images FILE... are valid bar masks.\n"
+		"\n"
+		"  --frames FILE...      frame images, in the order of the animation\n"
+		"  --strip-width N       strip width in pixels (default 3)\n"
+		"  --threads N           number of threads, 0 for one per core (default 0)\n"
+		"  --frames-on-disk      keep the frames in memory mapped scratch files\n"
+		"  --stream              compute band by band and write base image and bar mask\n"
+		"                        right away as uncompressed TIFF files, for animations\n"
+		"                        larger than memory (implies --frames-on-disk)\n"
+		"  --band-height N       number of rows computed at once by --stream (default 64)\n"
+		"  --base FILE           save base image to FILE\n"
+		"  --mask FILE           save bar mask image to FILE\n"
+		"  --svg FILE            save animation to SVG FILE (can be loaded again)\n"
+		"  --export-svg FILE     export animation to SVG FILE (can't be loaded again)\n"
+		"  --duration SECONDS    duration of the SVG animation (default number of frames)\n"
+		"  --compact             write smaller SVG files, without formatting and with the\n"
+		"                        bar mask as pattern\n"
+		"  --png-compression C   compression of PNG images, fast, default or small\n"
+		"                        (default default)\n"
+		"  --timings             report the time spent on every stage to stderr\n"
+		"  --trace FILE          record the stages with their threads to FILE, in the\n"
+		"                        trace-event format (also ANIMBAR_TRACE=FILE)\n"
+		"  --validate-mask FILE...  check every row of the bar mask images FILE... and\n"
+		"                        report their number of frames and strip width\n"
+		"  --help                display this help and exit\n"
+		"\n"
+		"Exit status is 0 on success, 1 on invalid options, 2 if a frame could not be\n"
+		"loaded or is no valid bar mask, 3 if the animation could not be computed and\n"
+		"4 if an output could not be written.\n").arg(ANIMBAR_PROG_NAME);
+}
+
+//----------------------------------------------------------------------
+
+/* Parse the command line into our members. */
+bool Batch::parse(const QStringList& arguments)
+{
+	for ( int i=1 ; i<arguments.size() ; i++ ) {
+		QString option = arguments[i];
+		bool hasValue = (i + 1 < arguments.size());
+		bool ok = true;
+
+		if (option == "--help") m_help = true;
+		else if (option == "--frames") {
+			while (i + 1 < arguments.size() && !arguments[i+1].startsWith("--"))
+				m_frames << arguments[++i];
+		}
+		else if (option == "--validate-mask") {
+			while (i + 1 < arguments.size() && !arguments[i+1].startsWith("--"))
+				m_validateMasks << arguments[++i];
+		}
+		else if (option == "--strip-width" && hasValue) m_stripWidth = arguments[++i].toInt(&ok);
+		else if (option == "--threads" && hasValue) m_threadCount = arguments[++i].toInt(&ok);
+		else if (option == "--duration" && hasValue) m_duration = arguments[++i].toDouble(&ok);
+		else if (option == "--base" && hasValue) m_base = arguments[++i];
+		else if (option == "--mask" && hasValue) m_mask = arguments[++i];
+		else if (option == "--svg" && hasValue) m_svg = arguments[++i];
+		else if (option == "--export-svg" && hasValue) m_exportSvg = arguments[++i];
+		else if (option == "--compact") m_compact = true;
+		else if (option == "--frames-on-disk") m_framesOnDisk = true;
+		else if (option == "--stream") m_stream = true;
+		else if (option == "--timings") m_timings = true;
+		else if (option == "--band-height" && hasValue) m_bandHeight = arguments[++i].toInt(&ok);
+		else if (option == "--png-compression" && hasValue) m_compression = PngWriter::fromString(arguments[++i], &ok);
+		else {
+			std::cerr << "Invalid option or missing value: " << option.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+
+		if (!ok) {
+			std::cerr << "Invalid value for " << option.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+	}
+
+	if (m_help) return true;
+
+	if (!m_validateMasks.isEmpty()) {
+		if (!m_frames.isEmpty()) {
+			std::cerr << "Frames (--frames) and masks to validate (--validate-mask) can't be mixed." << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	if (m_frames.isEmpty()) {
+		std::cerr << "No frames given (--frames)." << std::endl;
+		return false;
+	}
+
+	if (m_stripWidth <= 0) {
+		std::cerr << "The strip width must be positive." << std::endl;
+		return false;
+	}
+
+	if (m_base.isEmpty() && m_mask.isEmpty() && m_svg.isEmpty() && m_exportSvg.isEmpty()) {
+		std::cerr << "No output given (--base, --mask, --svg or --export-svg)." << std::endl;
+		return false;
+	}
+
+	if (m_stream) {
+		if (!m_svg.isEmpty() || !m_exportSvg.isEmpty()) {
+			std::cerr << "SVG files can't be streamed (--stream)." << std::endl;
+			return false;
+		}
+
+		QStringList outputs = QStringList() << m_base << m_mask;
+		foreach (const QString& output, outputs) {
+			QString suffix = QFileInfo(output).suffix().toLower();
+			if (!output.isEmpty() && suffix != "tif" && suffix != "tiff") {
+				std::cerr << "Streamed images are written as TIFF files (.tif or .tiff)." << std::endl;
+				return false;
+			}
+		}
+
+		if (m_bandHeight <= 0) {
+			std::cerr << "The band height must be positive." << std::endl;
+			return false;
+		}
+
+		/* only then we don't need to hold all frames in memory */
+		m_framesOnDisk = true;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Run the batch mode
+ *
+ * \param arguments The command line arguments including the program name
+ *
+ * \return One of ExitCode, to be returned from main().
+ */
+int Batch::run(const QStringList& arguments)
+{
+	if (!parse(arguments)) {
+		std::cerr << usage().toLocal8Bit().constData();
+		return UsageError;
+	}
+
+	if (m_help) {
+		std::cout << usage().toLocal8Bit().constData();
+		return Success;
+	}
+
+	if (!m_validateMasks.isEmpty()) return validateMasks();
+
+	/* load the frames, into scratch files if asked for */
+
+	FrameStore store;
+	ImageLoader loader(0, m_framesOnDisk ? &store : NULL);
+	std::vector< QImage > images(m_frames.size());
+	std::vector< QImage* > frames(m_frames.size());
+	for ( int i=0 ; i<m_frames.size() ; i++ ) {
+		LoadedImage loaded = loader(m_frames[i]);
+		if (!loaded.image) {
+			std::cerr << "Could not load image " << m_frames[i].toLocal8Bit().constData() << std::endl;
+			return InputError;
+		}
+		images[i] = *loaded.image;
+		delete loaded.image;
+		frames[i] = &images[i];
+
+		printTime("decode " + m_frames[i], loaded.decodeTime);
+		printTime("normalize " + m_frames[i], loaded.normalizeTime);
+
+		if (images[i].size() != images[0].size()) {
+			std::cerr << "All input images must be of same size. However, image "
+				<< m_frames[i].toLocal8Bit().constData() << " is not of reference pixel size "
+				<< images[0].width() << "x" << images[0].height() << "." << std::endl;
+			return InputError;
+		}
+	}
+
+	if (m_stripWidth > images[0].width()) {
+		std::cerr << "The strip width must not exceed the image width." << std::endl;
+		return UsageError;
+	}
+
+	if (m_stream) return stream(frames);
+
+	/* compute the animation */
+
+	Composer composer;
+	composer.setStripWidth(m_stripWidth);
+	composer.setThreadCount(m_threadCount);
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QImage baseImage, barMask;
+	if (!composer.setFrames(frames) || !composer.compose(baseImage, barMask)) {
+		std::cerr << "Failed to compute the animation." << std::endl;
+		return ComputeError;
+	}
+
+	printTime("compose", timer.restart());
+	printTime(QString("frames converted during compose: %1").arg(composer.nrConverted()), -1);
+
+	/* save whatever has been asked for */
+
+	if (!m_base.isEmpty() && !PngWriter::save(baseImage, m_base, m_compression)) {
+		std::cerr << "Failed to save base image to " << m_base.toLocal8Bit().constData() << std::endl;
+		return OutputError;
+	}
+
+	if (!m_mask.isEmpty() && !PngWriter::save(barMask, m_mask, m_compression)) {
+		std::cerr << "Failed to save bar mask to " << m_mask.toLocal8Bit().constData() << std::endl;
+		return OutputError;
+	}
+
+	if (!m_svg.isEmpty() && !saveSvg(m_svg, false, frames, baseImage, barMask))
+		return OutputError;
+
+	if (!m_exportSvg.isEmpty() && !saveSvg(m_exportSvg, true, frames, baseImage, barMask))
+		return OutputError;
+
+	printTime("save", timer.elapsed());
+
+	return Success;
+}
+
+//----------------------------------------------------------------------
+
+/* Decode and validate the bar masks of --validate-mask, one line per mask
+ * on stdout. We go on after a bad mask, so a whole archive is checked at
+ * once.
+ */
+int Batch::validateMasks() const
+{
+	int result = Success;
+
+	foreach (const QString& filename, m_validateMasks) {
+		std::cout << filename.toLocal8Bit().constData() << ": ";
+
+		QImage mask(filename);
+		if (mask.isNull()) {
+			std::cout << "could not be loaded" << std::endl;
+			result = InputError;
+			continue;
+		}
+		if (mask.format() == QImage::Format_MonoLSB) mask = mask.convertToFormat(QImage::Format_Mono);
+
+		unsigned int nrFrames, stripWidth;
+		BarMask::DecodeError error = BarMask::decode(mask, nrFrames, stripWidth, true);
+		if (error != BarMask::NoError) {
+			std::cout << BarMask::errorString(error) << std::endl;
+			result = InputError;
+			continue;
+		}
+
+		std::cout << "valid, " << nrFrames << " frames, strip width " << stripWidth << std::endl;
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------
+
+/* Report the time of a stage to stderr, if asked for by --timings. A
+ * negative time prints the stage only.
+ */
+void Batch::printTime(const QString& stage, qint64 time) const
+{
+	if (!m_timings) return;
+
+	std::cerr << "[timing] " << stage.toLocal8Bit().constData();
+	if (time >= 0) std::cerr << ": " << time << " ms";
+	std::cerr << std::endl;
+}
+
+//----------------------------------------------------------------------
+
+/* Compute the animation band by band and write base image and bar mask
+ * while computing, see Composer::stream().
+ */
+int Batch::stream(const std::vector< QImage* >& frames) const
+{
+	QFile baseFile(m_base), maskFile(m_mask);
+	TiffWriter baseWriter(&baseFile), maskWriter(&maskFile);
+
+	if (!m_base.isEmpty() && !baseFile.open(QIODevice::WriteOnly)) {
+		std::cerr << "Failed to open " << m_base.toLocal8Bit().constData() << " for writing." << std::endl;
+		return OutputError;
+	}
+
+	if (!m_mask.isEmpty() && !maskFile.open(QIODevice::WriteOnly)) {
+		std::cerr << "Failed to open " << m_mask.toLocal8Bit().constData() << " for writing." << std::endl;
+		return OutputError;
+	}
+
+	Composer composer;
+	composer.setStripWidth(m_stripWidth);
+	composer.setThreadCount(m_threadCount);
+
+	if (!composer.setFrames(frames)) {
+		std::cerr << "Failed to compute the animation." << std::endl;
+		return ComputeError;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	bool ok = composer.stream(
+		m_base.isEmpty() ? NULL : &baseWriter,
+		m_mask.isEmpty() ? NULL : &maskWriter,
+		m_bandHeight);
+
+	printTime("compose and save", timer.elapsed());
+
+	baseFile.close();
+	maskFile.close();
+
+	if (!ok || baseFile.error() != QFile::NoError || maskFile.error() != QFile::NoError) {
+		std::cerr << "Failed to write the streamed images." << std::endl;
+		return OutputError;
+	}
+
+	return Success;
+}
+
+//----------------------------------------------------------------------
+
+/* Save or export (exportOnly) the animation to an SVG file. */
+bool Batch::saveSvg(
+	const QString& filename,
+	bool exportOnly,
+	const std::vector< QImage* >& frames,
+	const QImage& baseImage,
+	const QImage& barMask) const
+{
+	unsigned int nrFrames = frames.size();
+	double duration = (m_duration >= 0.) ? m_duration : nrFrames;
+
+	QFile xmlFile(filename);
+	if (!xmlFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		std::cerr << "Failed to open " << filename.toLocal8Bit().constData() << " for writing." << std::endl;
+		return false;
+	}
+
+	SvgWriter::Style style = m_compact ? SvgWriter::Compact : SvgWriter::Formatted;
+
+	bool ok;
+	if (exportOnly) ok = SvgWriter::exportAnimation(&xmlFile, baseImage, barMask, m_stripWidth, nrFrames, duration, style, m_compression);
+	else ok = SvgWriter::saveAnimation(&xmlFile, frames, barMask, m_stripWidth, duration, style, m_compression);
+
+	xmlFile.close();
+
+	if (!ok || xmlFile.error() != QFile::NoError) {
+		std::cerr << "Failed to write " << filename.toLocal8Bit().constData() << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,88 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <vector>
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+
+#include "PngWriter.h"
+
+/*! \brief Computes and saves an animation from the command line
+ *
+ * The batch mode does without any window, so animbar may be scripted and
+ * run on machines without display, e.g.
+ *
+ *	animbar --frames a.png b.png c.png --strip-width 3 \
+ *		--base base.png --mask mask.png --svg anim.svg
+ *
+ * or check archived bar masks in bulk with --validate-mask.
+ *
+ * See usage() for all options.
+ */
+class Batch
+{
+public:
+	/*! Exit codes of run() */
+	enum ExitCode {
+		Success = 0,
+		UsageError = 1,
+		InputError = 2,
+		ComputeError = 3,
+		OutputError = 4
+	};
+
+	Batch();
+
+	/* documented in source code */
+	static bool isBatch(const QStringList&);
+	int run(const QStringList&);
+
+	static QString usage();
+
+private:
+	bool parse(const QStringList&);
+	int stream(const std::vector< QImage* >&) const;
+	int validateMasks() const;
+	void printTime(const QString&, qint64) const;
+	bool saveSvg(const QString&, bool, const std::vector< QImage* >&, const QImage&, const QImage&) const;
+
+	QStringList m_frames;
+	QStringList m_validateMasks;
+	int m_stripWidth;
+	int m_threadCount;
+	double m_duration;
+	QString m_base;
+	QString m_mask;
+	QString m_svg;
+	QString m_exportSvg;
+	bool m_compact;
+	bool m_framesOnDisk;
+	bool m_stream;
+	int m_bandHeight;
+	bool m_timings;
+	PngWriter::Compression m_compression;
+	bool m_help;
+};
+
+#endif // _BATCH_H
@@ -0,0 +1,627 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPainter>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+
+#include "animbar.h"
+#include "Benchmark.h"
+#include "BarMask.h"
+#include "Composer.h"
+#include "Interleaver.h"
+#include "MaskSelect.h"
+#include "PngWriter.h"
+#include "PreviewCompositor.h"
+#include "SvgWriter.h"
+
+//----------------------------------------------------------------------
+
+Benchmark::Benchmark() :
+	m_width(1920),
+	m_height(1080),
+	m_nrFrames(6),
+	m_format("argb"),
+	m_stripWidth(3),
+	m_threadCount(0),
+	m_repeat(3),
+	m_previewIdx(2),
+	m_legacy(false),
+	m_verbose(false),
+	m_help(false)
+{
+}
+
+//----------------------------------------------------------------------
+
+QString Benchmark::usage()
+{
+	return QString(
+		"Usage: %1_bench [OPTION]...\n"
+		"Time the stages of %1 on synthetic frames and report them as JSON.\n"
+		"\n"
+		"  --width N             width of the frames in pixels (default 1920)\n"
+		"  --height N            height of the frames in pixels (default 1080)\n"
+		"  --frames N            number of frames (default 6)\n"
+		"  --format F            format of the frames, argb, rgb, indexed or mono\n"
+		"                        (default argb)\n"
+		"  --strip-width N       strip width in pixels (default 3)\n"
+		"  --threads N           number of threads, 0 for one per core (default 0)\n"
+		"  --repeat N            number of runs of every stage (default 3)\n"
+		"  --preview N           slider position of the rendered preview (default 2)\n"
+		"  --legacy              also time the pixel by pixel composition and the\n"
+		"                        QPainter preview of earlier versions (slow)\n"
+		"  --output FILE         write the report to FILE instead of stdout\n"
+		"  --verbose             show the time of every stage on stderr as it is done\n"
+		"  --help                display this help and exit\n").arg(ANIMBAR_PROG_NAME);
+}
+
+//----------------------------------------------------------------------
+
+/* Parse the command line into our members. */
+bool Benchmark::parse(const QStringList& arguments)
+{
+	for ( int i=1 ; i<arguments.size() ; i++ ) {
+		QString option = arguments[i];
+		bool hasValue = (i + 1 < arguments.size());
+		bool ok = true;
+
+		if (option == "--help") m_help = true;
+		else if (option == "--width" && hasValue) m_width = arguments[++i].toInt(&ok);
+		else if (option == "--height" && hasValue) m_height = arguments[++i].toInt(&ok);
+		else if (option == "--frames" && hasValue) m_nrFrames = arguments[++i].toInt(&ok);
+		else if (option == "--format" && hasValue) m_format = arguments[++i];
+		else if (option == "--strip-width" && hasValue) m_stripWidth = arguments[++i].toInt(&ok);
+		else if (option == "--threads" && hasValue) m_threadCount = arguments[++i].toInt(&ok);
+		else if (option == "--repeat" && hasValue) m_repeat = arguments[++i].toInt(&ok);
+		else if (option == "--preview" && hasValue) m_previewIdx = arguments[++i].toInt(&ok);
+		else if (option == "--legacy") m_legacy = true;
+		else if (option == "--output" && hasValue) m_output = arguments[++i];
+		else if (option == "--verbose") m_verbose = true;
+		else {
+			std::cerr << "Invalid option or missing value: " << option.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+
+		if (!ok) {
+			std::cerr << "Invalid value for " << option.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+	}
+
+	if (m_help) return true;
+
+	if (m_width <= 0 || m_height <= 0 || m_nrFrames <= 0 || m_repeat <= 0) {
+		std::cerr << "Size, number of frames and repetitions must be positive." << std::endl;
+		return false;
+	}
+
+	if (m_stripWidth <= 0 || m_stripWidth > m_width) {
+		std::cerr << "The strip width must be positive and must not exceed the width." << std::endl;
+		return false;
+	}
+
+	if (m_format != "argb" && m_format != "rgb" && m_format != "indexed" && m_format != "mono") {
+		std::cerr << "Unknown format " << m_format.toLocal8Bit().constData() << std::endl;
+		return false;
+	}
+
+	if (m_previewIdx < 1 || m_previewIdx > m_nrFrames) m_previewIdx = 1;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Run all stages and write the report
+ *
+ * \param arguments The command line arguments including the program name
+ *
+ * \return Zero on success, one on invalid options and two if the report
+ *  could not be written.
+ */
+int Benchmark::run(const QStringList& arguments)
+{
+	if (!parse(arguments)) {
+		std::cerr << usage().toLocal8Bit().constData();
+		return 1;
+	}
+
+	if (m_help) {
+		std::cout << usage().toLocal8Bit().constData();
+		return 0;
+	}
+
+	/* the SVG writer encodes on the global pool */
+	if (m_threadCount > 0) QThreadPool::globalInstance()->setMaxThreadCount(m_threadCount);
+
+	generate();
+	benchLoad();
+	benchCompose();
+	benchPreview();
+	benchSave();
+
+	QByteArray json = report().toUtf8();
+
+	if (m_output.isEmpty()) {
+		std::cout << json.constData();
+		return 0;
+	}
+
+	QFile file(m_output);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text) || file.write(json) != json.size()) {
+		std::cerr << "Failed to write " << m_output.toLocal8Bit().constData() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------------
+
+/* Generate the frames: gradients that move from frame to frame, with some
+ * noise from a fixed seed so the PNG files are neither trivial nor random.
+ */
+void Benchmark::generate()
+{
+	QVector< QRgb > grays(256);
+	for ( int i=0 ; i<256 ; i++ ) grays[i] = qRgb(i, i, i);
+
+	quint32 seed = 2010;
+
+	m_frames.resize(m_nrFrames);
+	for ( int i=0 ; i<m_nrFrames ; i++ ) {
+		QImage::Format format = QImage::Format_ARGB32;
+		if (m_format == "rgb") format = QImage::Format_RGB32;
+		else if (m_format == "indexed") format = QImage::Format_Indexed8;
+		else if (m_format == "mono") format = QImage::Format_Mono;
+
+		QImage frame(m_width, m_height, format);
+		if (format == QImage::Format_Indexed8) frame.setColorTable(grays);
+		if (format == QImage::Format_Mono) {
+			frame.setColorCount(2);
+			frame.setColor(0, qRgb(0, 0, 0));
+			frame.setColor(1, qRgb(255, 255, 255));
+		}
+
+		for ( int row=0 ; row<m_height ; row++ ) {
+			uchar *line = frame.scanLine(row);
+			for ( int col=0 ; col<m_width ; col++ ) {
+				seed = seed * 1664525 + 1013904223;
+				int noise = seed >> 28;
+				int x = col + 32 * i;
+
+				switch (format) {
+				case QImage::Format_Indexed8:
+					line[col] = (x + row + noise) & 0xff;
+					break;
+				case QImage::Format_Mono:
+					if (((x / 16 + row / 16) & 1) != 0) line[col >> 3] |= 0x80 >> (col & 7);
+					else line[col >> 3] &= ~(0x80 >> (col & 7));
+					break;
+				default:
+					((QRgb*) line)[col] = qRgba(
+						(x + noise) & 0xff,
+						(row + noise) & 0xff,
+						(x + row) & 0xff,
+						format == QImage::Format_ARGB32 ? 128 + (row & 0x7f) : 255);
+				}
+			}
+		}
+
+		m_frames[i] = frame;
+	}
+}
+
+//----------------------------------------------------------------------
+
+/* Encode the frames to PNG files at every compression, then decode and
+ * normalize them as ImageLoader does.
+ */
+void Benchmark::benchLoad()
+{
+	PngWriter::Compression compressions[] = { PngWriter::Fast, PngWriter::Default, PngWriter::Small };
+	QElapsedTimer timer;
+
+	for ( int c=0 ; c<3 ; c++ ) {
+		QVector< qint64 > times;
+		QVector< QByteArray > files(m_nrFrames);
+		qint64 bytes = 0;
+		for ( int r=0 ; r<m_repeat ; r++ ) {
+			timer.start();
+			for ( int i=0 ; i<m_nrFrames ; i++ ) files[i] = SvgWriter::encodePng(m_frames[i], compressions[c]);
+			times << timer.nsecsElapsed();
+		}
+		for ( int i=0 ; i<m_nrFrames ; i++ ) bytes += files[i].size();
+		addStage("png_encode_frames/" + PngWriter::toString(compressions[c]), times, bytes);
+
+		if (compressions[c] == PngWriter::Default) m_pngFiles = files;
+	}
+
+	QVector< qint64 > times;
+	std::vector< QImage > decoded(m_nrFrames);
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		for ( int i=0 ; i<m_nrFrames ; i++ ) decoded[i] = QImage::fromData(m_pngFiles[i]);
+		times << timer.nsecsElapsed();
+	}
+	addStage("decode", times);
+
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		for ( int i=0 ; i<m_nrFrames ; i++ ) {
+			QImage::Format canonical = Interleaver::canonicalFormat(decoded[i]);
+			if (decoded[i].format() != canonical) m_frames[i] = decoded[i].convertToFormat(canonical);
+			else m_frames[i] = decoded[i];
+		}
+		times << timer.nsecsElapsed();
+	}
+	addStage("normalize", times);
+}
+
+//----------------------------------------------------------------------
+
+/* Interleave the base image and build the bar mask, separately on one
+ * thread and together with the Composer.
+ */
+void Benchmark::benchCompose()
+{
+	std::vector< QImage* > frames(m_nrFrames);
+	for ( int i=0 ; i<m_nrFrames ; i++ ) frames[i] = &m_frames[i];
+
+	QElapsedTimer timer;
+	QVector< qint64 > times;
+	qint64 pixels = (qint64) m_width * m_height;
+
+	Interleaver interleaver;
+	interleaver.setStripWidth(m_stripWidth);
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		interleaver.setFrames(frames);
+		QImage baseImage;
+		interleaver.compose(baseImage);
+		times << timer.nsecsElapsed();
+	}
+	addStage("interleave", times, -1, pixels);
+
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		QImage barMask;
+		BarMask::create(barMask, QSize(m_width, m_height), m_stripWidth, m_nrFrames);
+		times << timer.nsecsElapsed();
+	}
+	addStage("bar_mask", times);
+
+	Composer composer;
+	composer.setStripWidth(m_stripWidth);
+	composer.setThreadCount(m_threadCount);
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		composer.setFrames(frames);
+		composer.compose(m_baseImage, m_barMask);
+		times << timer.nsecsElapsed();
+	}
+	addStage("compose", times, -1, pixels);
+
+	/* swap the first two frames back and forth, which rewrites 2 of
+	 * m_nrFrames strips of the base image in place.
+	 */
+	if (m_nrFrames > 1) {
+		std::vector< bool > changed(m_nrFrames, false);
+		changed[0] = changed[1] = true;
+		QImage baseImage = m_baseImage.copy();
+		times.clear();
+		for ( int r=0 ; r<m_repeat ; r++ ) {
+			std::swap(frames[0], frames[1]);
+			timer.start();
+			composer.setFrames(frames);
+			composer.update(baseImage, changed);
+			times << timer.nsecsElapsed();
+		}
+		addStage("compose_update", times);
+	}
+
+	if (!m_legacy) return;
+
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		QImage baseImage;
+		timer.start();
+		interleaveLegacy(frames, m_stripWidth, baseImage);
+		times << timer.nsecsElapsed();
+	}
+	addStage("interleave_legacy", times, -1, pixels);
+}
+
+//----------------------------------------------------------------------
+
+/* Render a preview with the PreviewCompositor and with every masked-select
+ * kernel the machine supports. The kernels select from the full color base
+ * image, as PreviewCompositor does for narrow strips.
+ */
+void Benchmark::benchPreview()
+{
+	QElapsedTimer timer;
+	QVector< qint64 > times;
+	qint64 pixels = (qint64) m_width * m_height;
+
+	PreviewCompositor preview;
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		preview.setBase(m_baseImage, m_stripWidth, m_nrFrames);
+		times << timer.nsecsElapsed();
+	}
+	addStage("preview_set_base", times, -1, pixels);
+
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		preview.render(m_previewIdx);
+		times << timer.nsecsElapsed();
+	}
+	addStage("preview_render", times, -1, pixels);
+
+	QImage base = m_baseImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+	QImage result(base.size(), base.format());
+	int bytesPerLine = (m_width + 7) / 8;
+	QVector< uchar > mask(bytesPerLine);
+	BarMask::fillRow(mask.data(), bytesPerLine, m_width, m_stripWidth, m_nrFrames, m_stripWidth * (m_previewIdx - 1));
+
+	MaskSelect::Kernel kernels[] = { MaskSelect::Scalar, MaskSelect::SSE2, MaskSelect::AVX2 };
+	for ( int k=0 ; k<3 ; k++ ) {
+		if (!MaskSelect::isSupported(kernels[k])) continue;
+
+		times.clear();
+		for ( int r=0 ; r<m_repeat ; r++ ) {
+			timer.start();
+			for ( int row=0 ; row<m_height ; row++ )
+				MaskSelect::selectRow(
+					kernels[k],
+					(const quint32*) base.constScanLine(row),
+					mask.constData(),
+					(quint32*) result.scanLine(row),
+					m_width);
+			times << timer.nsecsElapsed();
+		}
+		addStage(QString("mask_select/") + MaskSelect::name(kernels[k]), times, -1, pixels);
+	}
+
+	if (!m_legacy) return;
+
+	times.clear();
+	for ( int r=0 ; r<m_repeat ; r++ ) {
+		timer.start();
+		renderLegacy(base, m_barMask, m_stripWidth * (m_previewIdx - 1), result);
+		times << timer.nsecsElapsed();
+	}
+	addStage("preview_qpainter", times, -1, pixels);
+}
+
+//----------------------------------------------------------------------
+
+/* Encode base image and bar mask at every compression, to memory, and
+ * write the SVG animation in both styles, to temporary files.
+ */
+void Benchmark::benchSave()
+{
+	PngWriter::Compression compressions[] = { PngWriter::Fast, PngWriter::Default, PngWriter::Small };
+	QElapsedTimer timer;
+
+	for ( int c=0 ; c<3 ; c++ ) {
+		QString name = PngWriter::toString(compressions[c]);
+		QVector< qint64 > baseTimes, maskTimes;
+		qint64 baseBytes = 0, maskBytes = 0;
+
+		for ( int r=0 ; r<m_repeat ; r++ ) {
+			timer.start();
+			baseBytes = SvgWriter::encodePng(m_baseImage, compressions[c]).size();
+			baseTimes << timer.nsecsElapsed();
+
+			timer.start();
+			maskBytes = SvgWriter::encodePng(m_barMask, compressions[c]).size();
+			maskTimes << timer.nsecsElapsed();
+		}
+
+		addStage("png_encode_base/" + name, baseTimes, baseBytes);
+		addStage("png_encode_mask/" + name, maskTimes, maskBytes);
+	}
+
+	std::vector< QImage* > frames(m_nrFrames);
+	for ( int i=0 ; i<m_nrFrames ; i++ ) frames[i] = &m_frames[i];
+
+	SvgWriter::Style styles[] = { SvgWriter::Formatted, SvgWriter::Compact };
+	const char* styleNames[] = { "formatted", "compact" };
+	for ( int s=0 ; s<2 ; s++ ) {
+		QVector< qint64 > times;
+		qint64 bytes = 0, peakRss = -1;
+		for ( int r=0 ; r<m_repeat ; r++ ) {
+			/* to a file, a buffer would hold the whole SVG in memory */
+			QTemporaryFile file;
+			file.open();
+			qint64 rss = resetPeakRss();
+			timer.start();
+			SvgWriter::saveAnimation(&file, frames, m_barMask, m_stripWidth, m_nrFrames, styles[s]);
+			times << timer.nsecsElapsed();
+			if (rss >= 0) peakRss = qMax(peakRss, procStatus("VmHWM:") - rss);
+			bytes = file.size();
+		}
+		addStage(QString("svg_write/") + styleNames[s], times, bytes, -1, peakRss);
+	}
+}
+
+//----------------------------------------------------------------------
+
+/* Add a stage to the report, with the minimum and median of its run
+ * times. bytes is the size of what the stage produced, if any. pixels is
+ * the number of pixels the stage produced, if it makes images, reported
+ * as megapixels per second of the fastest run. peakRss is how many
+ * kilobytes the resident set size grew by at most during a run, if
+ * measured. With --verbose, the stage is also shown on std::cerr.
+ */
+void Benchmark::addStage(const QString& name, const QVector< qint64 >& nsecs, qint64 bytes, qint64 pixels, qint64 peakRss)
+{
+	QVector< qint64 > sorted = nsecs;
+	std::sort(sorted.begin(), sorted.end());
+
+	QString stage = QString("    {\"name\": \"%1\", \"runs\": %2, \"minMs\": %3, \"medianMs\": %4")
+		.arg(name)
+		.arg(sorted.size())
+		.arg(sorted.first() / 1e6, 0, 'f', 3)
+		.arg(sorted[sorted.size() / 2] / 1e6, 0, 'f', 3);
+	if (bytes >= 0) stage += QString(", \"bytes\": %1").arg(bytes);
+	if (pixels >= 0) stage += QString(", \"mpixPerSec\": %1").arg(pixels * 1e3 / qMax(sorted.first(), (qint64) 1), 0, 'f', 1);
+	if (peakRss >= 0) stage += QString(", \"peakRssKB\": %1").arg(peakRss);
+	stage += "}";
+
+	m_stages << stage;
+
+	if (m_verbose)
+		std::cerr << name.toLocal8Bit().constData() << ": " << sorted.first() / 1000000 << " ms" << std::endl;
+}
+
+//----------------------------------------------------------------------
+
+/* Reset the peak resident set size of the process to the current one, so
+ * VmHWM tells the peak of what runs next. Returns the current resident set
+ * size in kilobytes, or -1 if the peak can't be reset, as on systems other
+ * than Linux.
+ */
+qint64 Benchmark::resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+	FILE *clearRefs = fopen("/proc/self/clear_refs", "w");
+	if (clearRefs == NULL) return -1;
+	bool ok = (fputs("5", clearRefs) >= 0);
+	ok = (fclose(clearRefs) == 0) && ok;
+
+	return ok ? procStatus("VmRSS:") : -1;
+#else
+	return -1;
+#endif
+}
+
+//----------------------------------------------------------------------
+
+/* A field of /proc/self/status in kilobytes, e.g. "VmHWM:", or -1. */
+qint64 Benchmark::procStatus(const char* field)
+{
+	qint64 kb = -1;
+
+#ifdef Q_OS_LINUX
+	FILE *status = fopen("/proc/self/status", "r");
+	if (status == NULL) return -1;
+
+	char line[256];
+	while (fgets(line, sizeof(line), status) != NULL) {
+		if (strncmp(line, field, strlen(field)) != 0) continue;
+		long long value;
+		if (sscanf(line + strlen(field), "%lld", &value) == 1) kb = value;
+		break;
+	}
+
+	fclose(status);
+#else
+	Q_UNUSED(field);
+#endif
+
+	return kb;
+}
+
+//----------------------------------------------------------------------
+
+/* The JSON report: the configuration and all stages in the order run. */
+QString Benchmark::report() const
+{
+	int threads = (m_threadCount > 0) ? m_threadCount : qMax(QThread::idealThreadCount(), 1);
+
+	return QString(
+		"{\n"
+		"  \"program\": \"%1\",\n"
+		"  \"version\": \"%2.%3\",\n"
+		"  \"config\": {\"width\": %4, \"height\": %5, \"frames\": %6, \"format\": \"%7\", "
+		"\"stripWidth\": %8, \"threads\": %9, \"repeat\": %10, \"preview\": %11, "
+		"\"maskSelectKernel\": \"%12\"},\n"
+		"  \"stages\": [\n%13\n"
+		"  ]\n"
+		"}\n")
+		.arg(ANIMBAR_PROG_NAME)
+		.arg(ANIMBAR_VERSION_MAJOR)
+		.arg(ANIMBAR_VERSION_MINOR)
+		.arg(m_width)
+		.arg(m_height)
+		.arg(m_nrFrames)
+		.arg(m_format)
+		.arg(m_stripWidth)
+		.arg(threads)
+		.arg(m_repeat)
+		.arg(m_previewIdx)
+		.arg(MaskSelect::name(MaskSelect::kernel()))
+		.arg(m_stages.join(",\n"));
+}
+
+//----------------------------------------------------------------------
+
+/* The column by column composition of animbar 1.0, for comparison. */
+void Benchmark::interleaveLegacy(const std::vector< QImage* >& imgs, int stripWidth, QImage& baseImage)
+{
+	int nrImgs = imgs.size();
+	QSize size0 = imgs[0]->size();
+
+	baseImage = QImage(size0, QImage::Format_ARGB32_Premultiplied);
+
+	for ( int col=0 ; col<size0.width() ; )
+		for ( int i=0 ; i<nrImgs ; i++ )
+			for ( int j=0 ; j<stripWidth && col<size0.width() ; j++, col++ )
+				for ( int row=0 ; row<size0.height() ; row++ )
+					baseImage.setPixel(col, row, imgs[i]->pixel(col, row));
+}
+
+//----------------------------------------------------------------------
+
+/* The QPainter preview of animbar 1.0: the shifted bar mask multiplied
+ * with the base image, for comparison.
+ */
+void Benchmark::renderLegacy(const QImage& baseImage, const QImage& barMask, int offset, QImage& image)
+{
+	QPainter painter(&image);
+
+	if (offset > 0) {
+		painter.setPen(QColor(0,0,0));
+		painter.fillRect(0, 0, offset, image.height(), Qt::SolidPattern);
+	}
+
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.drawImage(offset, 0, barMask);
+
+	painter.setCompositionMode(QPainter::CompositionMode_Multiply);
+	painter.drawImage(0, 0, baseImage);
+
+	painter.end();
+}
@@ -0,0 +1,93 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*! \brief Times the stages of animbar on synthetic frames
+ *
+ * The frames are generated, so runs are reproducible and do not depend on
+ * any input files. Every stage is run a number of times, the report is
+ * JSON to be compared between releases, e.g.
+ *
+ *	animbar_bench --width 3840 --height 2160 --frames 8 --output 4k.json
+ *
+ * On Linux, the SVG stages also report how much the peak resident set
+ * size grew while writing, as peakRssKB. See usage() for all options.
+ */
+class Benchmark
+{
+public:
+	Benchmark();
+
+	/* documented in source code */
+	int run(const QStringList&);
+
+	static QString usage();
+
+private:
+	bool parse(const QStringList&);
+
+	void generate();
+	void benchLoad();
+	void benchCompose();
+	void benchPreview();
+	void benchSave();
+
+	void addStage(const QString&, const QVector< qint64 >&, qint64 = -1, qint64 = -1, qint64 = -1);
+	QString report() const;
+
+	static void interleaveLegacy(const std::vector< QImage* >&, int, QImage&);
+	static void renderLegacy(const QImage&, const QImage&, int, QImage&);
+
+	static qint64 resetPeakRss();
+	static qint64 procStatus(const char*);
+
+	int m_width;
+	int m_height;
+	int m_nrFrames;
+	QString m_format;
+	int m_stripWidth;
+	int m_threadCount;
+	int m_repeat;
+	int m_previewIdx;
+	bool m_legacy;
+	QString m_output;
+	bool m_verbose;
+	bool m_help;
+
+	/* the synthetic frames, their PNG files and the results */
+	std::vector< QImage > m_frames;
+	QVector< QByteArray > m_pngFiles;
+	QImage m_baseImage;
+	QImage m_barMask;
+
+	/* one JSON object per stage */
+	QStringList m_stages;
+};
+
+#endif // _BENCHMARK_H
@@ -0,0 +1,482 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include "Composer.h"
+#include "BarMask.h"
+#include "TiffWriter.h"
+#include "Trace.h"
+
+//----------------------------------------------------------------------
+
+/* One band of rows of base image and bar mask, executed on the thread
+ * pool in Composer::compose(). A band is small enough to let a cancel
+ * take effect within milliseconds. baseRows points to the first row of
+ * the band, maskBits to the complete bar mask, which may be NULL if only
+ * the base image is needed. If phases is given, only the strips of these
+ * frames are written, see Interleaver::composeRows().
+ */
+class ComposerBand : public QRunnable
+{
+public:
+	ComposerBand(
+		Composer& composer,
+		unsigned char *baseRows, int baseBpl,
+		unsigned char *maskBits, int maskBpl,
+		const unsigned char *maskLine,
+		int rowBegin, int rowEnd,
+		const std::vector< bool > *phases = NULL) :
+		m_composer(composer),
+		m_baseRows(baseRows), m_baseBpl(baseBpl),
+		m_maskBits(maskBits), m_maskBpl(maskBpl),
+		m_maskLine(maskLine),
+		m_rowBegin(rowBegin), m_rowEnd(rowEnd),
+		m_phases(phases)
+	{
+	}
+
+	void run()
+	{
+		if (m_composer.isCanceled()) return;
+
+		TraceSpan span("composeBand");
+
+		m_composer.m_interleaver.composeRows(m_baseRows, m_baseBpl, m_rowBegin, m_rowEnd, m_phases);
+		if (m_maskBits)
+			BarMask::copyRows(m_maskBits, m_maskBpl, m_maskLine, m_rowBegin, m_rowEnd);
+
+		m_composer.bandDone(m_rowEnd - m_rowBegin);
+	}
+
+private:
+	Composer& m_composer;
+	unsigned char *m_baseRows;
+	int m_baseBpl;
+	unsigned char *m_maskBits;
+	int m_maskBpl;
+	const unsigned char *m_maskLine;
+	int m_rowBegin;
+	int m_rowEnd;
+	const std::vector< bool > *m_phases;
+};
+
+//----------------------------------------------------------------------
+
+Composer::Composer(QObject *parent) :
+	QObject(parent),
+	m_threadCount(0),
+	m_nrRewritten(0),
+	m_canceled(0),
+	m_rowsDone(0),
+	m_percentDone(0),
+	m_rowsTotal(0)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the input frames
+ *
+ * We keep shallow copies of the frames, so they stay valid even if the
+ * caller deletes its images while we compute in the background. Format
+ * conversion is left to compose(), see Interleaver::setFrames().
+ *
+ * \return False, if there are no frames or they differ in size.
+ */
+bool Composer::setFrames(const std::vector< QImage* >& frames)
+{
+	m_frames.clear();
+
+	if (frames.empty()) return false;
+
+	for ( unsigned int i=0 ; i<frames.size() ; i++ ) {
+		if (frames[i]->size() != frames[0]->size()) {
+			m_frames.clear();
+			return false;
+		}
+		m_frames.push_back(*frames[i]);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void Composer::setStripWidth(int stripWidth)
+{
+	m_interleaver.setStripWidth(stripWidth);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the number of threads to compose with
+ *
+ * \param threadCount Number of threads, values smaller than one select the
+ *  number of processor cores.
+ */
+void Composer::setThreadCount(int threadCount)
+{
+	m_threadCount = threadCount;
+}
+
+//----------------------------------------------------------------------
+
+int Composer::threadCount() const
+{
+	if (m_threadCount > 0) return m_threadCount;
+	return qMax(QThread::idealThreadCount(), 1);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compute base image and bar mask
+ *
+ * Both images are split into bands of rows, several per thread to even out
+ * the load, that are filled on a thread pool of threadCount() threads. With
+ * a single thread, the bands are filled right here.
+ *
+ * \param baseImage (out) The base image, in Interleaver::baseFormat()
+ * \param barMask (out) The bar mask image in QImage::Format_Mono
+ *
+ * \return False, if no frames have been set, the images could not be
+ *  allocated or the computation has been canceled.
+ */
+bool Composer::compose(QImage& baseImage, QImage& barMask)
+{
+	TraceSpan span("compose");
+
+	QSize size0 = prepare();
+	if (size0.isEmpty()) return false;
+
+	baseImage = QImage(size0, m_interleaver.baseFormat());
+	barMask = QImage(size0, QImage::Format_Mono);
+	if (baseImage.isNull() || barMask.isNull()) return false;
+	if (!m_interleaver.colorTable().isEmpty()) baseImage.setColorTable(m_interleaver.colorTable());
+
+	/* get the raw buffers here, QImage::bits() may detach and must not be
+	 * called from the worker threads.
+	 */
+	unsigned char *baseBits = baseImage.bits();
+	unsigned char *maskBits = barMask.bits();
+
+	/* all rows of the bar mask are the same, so we build the first one
+	 * once and let the bands copy it.
+	 */
+	std::vector< unsigned char > maskLine(barMask.bytesPerLine());
+	BarMask::fillRow(
+		&maskLine[0],
+		barMask.bytesPerLine(),
+		size0.width(),
+		m_interleaver.stripWidth(),
+		m_interleaver.nrFrames());
+
+	runBands(
+		baseBits, baseImage.bytesPerLine(),
+		maskBits, barMask.bytesPerLine(),
+		&maskLine[0],
+		size0.height(),
+		NULL);
+
+	if (isCanceled()) {
+		baseImage = QImage();
+		barMask = QImage();
+		return false;
+	}
+
+	m_nrRewritten = m_interleaver.nrFrames();
+	span.setBytes(baseImage.byteCount() + barMask.byteCount());
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Rewrite the strips of some frames of a base image
+ *
+ * Column col of the base image is taken from frame (col / stripWidth) %
+ * nrFrames. If frames have been reordered or replaced, but their number,
+ * size and the strip width are the same, only the strips of the frames at
+ * the positions that changed need to be written again. The bar mask stays
+ * the same. Changing one of N frames thus costs 1/N of compose().
+ *
+ * The strips are written in place, in bands on the thread pool as in
+ * compose(). Note that QImage::bits() detaches baseImage first if its
+ * pixels are shared with other QImages, which copies the whole image.
+ *
+ * \param baseImage (in/out) The base image of the frames before the
+ *  change
+ * \param changed changed[i] is set if frame i is new at its position
+ *
+ * \return False, if no frames have been set, baseImage does not match
+ *  them (also if a new frame changed Interleaver::baseFormat()) or the
+ *  computation has been canceled. In the latter case, baseImage is only
+ *  partially updated.
+ */
+bool Composer::update(QImage& baseImage, const std::vector< bool >& changed)
+{
+	TraceSpan span("update");
+
+	QSize size0 = prepare();
+	if (size0.isEmpty()) return false;
+
+	if (baseImage.size() != size0 ||
+		baseImage.format() != m_interleaver.baseFormat() ||
+		baseImage.colorTable() != m_interleaver.colorTable() ||
+		changed.size() != (size_t) m_interleaver.nrFrames())
+		return false;
+
+	unsigned char *baseBits = baseImage.bits();
+
+	runBands(
+		baseBits, baseImage.bytesPerLine(),
+		NULL, 0,
+		NULL,
+		size0.height(),
+		&changed);
+
+	if (isCanceled()) return false;
+
+	m_nrRewritten = 0;
+	for ( unsigned int i=0 ; i<changed.size() ; i++ )
+		if (changed[i]) m_nrRewritten++;
+	span.setBytes((qint64) baseImage.byteCount() * m_nrRewritten / changed.size());
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/* Fill the rows [0, height) of the base image, and of the bar mask if
+ * maskBits is given, in bands. Several bands per thread even out the load.
+ * With a single thread, the bands are filled right here. See ComposerBand
+ * for phases.
+ */
+void Composer::runBands(
+	unsigned char* baseBits, int baseBpl,
+	unsigned char* maskBits, int maskBpl,
+	const unsigned char* maskLine,
+	int height,
+	const std::vector< bool >* phases)
+{
+	int nrThreads = threadCount();
+	int bandHeight = qBound(1, height / (4 * nrThreads), 32);
+
+	if (nrThreads == 1) {
+		for ( int row=0 ; row<height ; row+=bandHeight )
+			ComposerBand(
+				*this,
+				baseBits + (size_t) row * baseBpl, baseBpl,
+				maskBits, maskBpl,
+				maskLine,
+				row, qMin(row + bandHeight, height),
+				phases).run();
+	} else {
+		QThreadPool pool;
+		pool.setMaxThreadCount(nrThreads);
+		for ( int row=0 ; row<height ; row+=bandHeight )
+			pool.start(new ComposerBand(
+				*this,
+				baseBits + (size_t) row * baseBpl, baseBpl,
+				maskBits, maskBpl,
+				maskLine,
+				row, qMin(row + bandHeight, height),
+				phases));
+		pool.waitForDone();
+	}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compute base image and bar mask band by band into TIFF files
+ *
+ * In contrast to compose(), only bandHeight rows of the base image are
+ * held in memory at a time. The rows of a band are computed on the thread
+ * pool and written before the next band is started. Together with frames
+ * kept in a FrameStore, this allows for animations larger than memory.
+ *
+ * \param baseWriter Writer for the base image, may be NULL
+ * \param maskWriter Writer for the bar mask, may be NULL
+ * \param bandHeight Number of rows computed at once, also the number of
+ *  rows per TIFF strip
+ *
+ * \return False, if no frames have been set, writing failed or the
+ *  computation has been canceled. The files are incomplete then.
+ */
+bool Composer::stream(TiffWriter* baseWriter, TiffWriter* maskWriter, int bandHeight)
+{
+	TraceSpan span("stream");
+
+	/* TiffWriter takes full color base images only */
+	QSize size0 = prepare(false);
+	if (size0.isEmpty() || bandHeight <= 0) return false;
+
+	bandHeight = qMin(bandHeight, size0.height());
+
+	if (baseWriter && !baseWriter->begin(size0, m_interleaver.baseFormat(), bandHeight)) return false;
+	if (maskWriter && !maskWriter->begin(size0, QImage::Format_Mono, bandHeight)) return false;
+
+	/* one band of the base image, without padding */
+	int baseBpl = 4 * size0.width();
+	std::vector< unsigned char > band(baseWriter ? (size_t) baseBpl * bandHeight : 0);
+
+	/* the bar mask's rows are all the same */
+	std::vector< unsigned char > maskLine((size0.width() + 31) / 32 * 4);
+	BarMask::fillRow(
+		&maskLine[0],
+		(int) maskLine.size(),
+		size0.width(),
+		m_interleaver.stripWidth(),
+		m_interleaver.nrFrames());
+
+	int nrThreads = threadCount();
+	QThreadPool pool;
+	pool.setMaxThreadCount(nrThreads);
+
+	for ( int bandBegin=0 ; bandBegin<size0.height() ; bandBegin+=bandHeight ) {
+		int bandEnd = qMin(bandBegin + bandHeight, size0.height());
+
+		if (baseWriter) {
+			/* split the band evenly over the threads */
+			int rows = qMax(1, (bandEnd - bandBegin + nrThreads - 1) / nrThreads);
+			for ( int row=bandBegin ; row<bandEnd ; row+=rows ) {
+				ComposerBand *part = new ComposerBand(
+					*this,
+					&band[0] + (size_t) (row - bandBegin) * baseBpl, baseBpl,
+					NULL, 0,
+					NULL,
+					row, qMin(row + rows, bandEnd));
+				if (nrThreads == 1) {
+					part->run();
+					delete part;
+				} else pool.start(part);
+			}
+			pool.waitForDone();
+
+			if (isCanceled()) return false;
+			if (!baseWriter->writeRows(&band[0], baseBpl, bandEnd - bandBegin)) return false;
+		} else {
+			if (isCanceled()) return false;
+			bandDone(bandEnd - bandBegin);
+		}
+
+		if (maskWriter && !maskWriter->writeRows(&maskLine[0], 0, bandEnd - bandBegin)) return false;
+	}
+
+	if (baseWriter && !baseWriter->end()) return false;
+	if (maskWriter && !maskWriter->end()) return false;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/* Hand the frames to the interleaver, which converts them if needed, and
+ * reset the progress. Returns the size of the animation, empty if there
+ * are no frames. See Interleaver::setFrames() for reduceDepth.
+ */
+QSize Composer::prepare(bool reduceDepth)
+{
+	std::vector< QImage* > frames(m_frames.size());
+	for ( unsigned int i=0 ; i<m_frames.size() ; i++ ) frames[i] = &m_frames[i];
+	if (!m_interleaver.setFrames(frames, reduceDepth)) return QSize();
+
+	m_rowsDone = 0;
+	m_percentDone = 0;
+	m_rowsTotal = m_interleaver.size().height();
+
+	return m_interleaver.size();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the results of the frames before a change
+ *
+ * The next run() then only rewrites the strips of the changed frames, see
+ * update(). The composer works on its own copy of baseImage, so the
+ * caller's images stay intact if the update fails or is canceled.
+ */
+void Composer::setPrevious(const QImage& baseImage, const QImage& barMask, const std::vector< bool >& changed)
+{
+	m_baseImage = baseImage.copy();
+	m_barMask = barMask;
+	m_changed = changed;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compute base image and bar mask into baseImage() and barMask()
+ *
+ * This is meant to be run in the background, e.g. by QtConcurrent::run().
+ * If previous results have been set by setPrevious(), they are updated,
+ * unless they do not fit the frames or the strip width anymore. Then, and
+ * without previous results, everything is computed. Both ways stop if the
+ * computation is canceled.
+ *
+ * \return See compose() and update().
+ */
+bool Composer::run()
+{
+	/* the bar mask is kept, so it must be the one of the frames */
+	unsigned int nrFrames, stripWidth;
+	if (!m_changed.empty() &&
+		BarMask::decode(m_barMask, nrFrames, stripWidth) == BarMask::NoError &&
+		nrFrames == m_changed.size() &&
+		(int) stripWidth == m_interleaver.stripWidth()) {
+		if (update(m_baseImage, m_changed)) return true;
+		if (isCanceled()) return false;
+	}
+
+	return compose(m_baseImage, m_barMask);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Stop a running computation
+ *
+ * Bands that have not been started yet are skipped, so compose() returns
+ * within the time it takes to fill a single band.
+ */
+void Composer::cancel()
+{
+	m_canceled = 1;
+}
+
+//----------------------------------------------------------------------
+
+/* Called by the bands from the worker threads. We emit progressChanged()
+ * only if the percentage has increased, which limits the number of
+ * signals sent to the GUI thread to 100.
+ */
+void Composer::bandDone(int rows)
+{
+	int rowsDone = m_rowsDone.fetchAndAddOrdered(rows) + rows;
+	int percent = (int) ((qint64) 100 * rowsDone / m_rowsTotal);
+
+	int previous = m_percentDone;
+	while (percent > previous) {
+		if (m_percentDone.testAndSetOrdered(previous, percent)) {
+			emit progressChanged(percent);
+			break;
+		}
+		previous = m_percentDone;
+	}
+}
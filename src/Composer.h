@@ -0,0 +1,115 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMPOSER_H
+#define _COMPOSER_H
+
+#include <vector>
+
+#include <QObject>
+#include <QImage>
+#include <QAtomicInt>
+
+#include "Interleaver.h"
+
+class TiffWriter;
+
+/*! \brief Computes base image and bar mask of an animation
+ *
+ * Every row of the base image and of the bar mask only depends on the same
+ * row of the input frames. The composer hence splits both images into
+ * horizontal bands and fills them concurrently on a pool of threadCount()
+ * threads. The result does not depend on the number of threads.
+ *
+ * A composer may run in the background, see run(). It then reports its
+ * progress through progressChanged() and stops as soon as possible after
+ * cancel() has been called.
+ */
+class Composer : public QObject
+{
+	Q_OBJECT
+
+public:
+	Composer(QObject *parent = NULL);
+
+	/* documented in source code */
+	bool setFrames(const std::vector< QImage* >&);
+	void setStripWidth(int);
+	void setThreadCount(int);
+	int threadCount() const;
+
+	/* documented in source code */
+	bool compose(QImage&, QImage&);
+	bool update(QImage&, const std::vector< bool >&);
+	bool stream(TiffWriter*, TiffWriter*, int);
+	void setPrevious(const QImage&, const QImage&, const std::vector< bool >&);
+	bool run();
+
+	bool isCanceled() const { return m_canceled != 0; }
+
+	/*! Number of frames that had to be converted by the last computation */
+	int nrConverted() const { return m_interleaver.nrConverted(); }
+	/*! Number of frames whose strips have been written by the last
+	 * computation, see update()
+	 */
+	int nrRewritten() const { return m_nrRewritten; }
+
+	const QImage& baseImage() const { return m_baseImage; }
+	const QImage& barMask() const { return m_barMask; }
+
+public slots:
+	void cancel();
+
+signals:
+	/*! Progress in percent, emitted from the worker threads at most once
+	 * per percent.
+	 */
+	void progressChanged(int);
+
+private:
+	friend class ComposerBand;
+
+	QSize prepare(bool = true);
+	void runBands(
+		unsigned char*, int,
+		unsigned char*, int,
+		const unsigned char*,
+		int,
+		const std::vector< bool >*);
+	void bandDone(int);
+
+	std::vector< QImage > m_frames;
+	Interleaver m_interleaver;
+	int m_threadCount;
+	int m_nrRewritten;
+
+	QAtomicInt m_canceled;
+	QAtomicInt m_rowsDone;
+	QAtomicInt m_percentDone;
+	int m_rowsTotal;
+
+	/* the results of run(), and the frames that changed since the
+	 * previous results, see setPrevious()
+	 */
+	QImage m_baseImage;
+	QImage m_barMask;
+	std::vector< bool > m_changed;
+};
+
+#endif // _COMPOSER_H
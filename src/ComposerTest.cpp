@@ -0,0 +1,288 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "BarMask.h"
+#include "Composer.h"
+#include "Tests.h"
+
+static const QImage::Format formats[] = {QImage::Format_ARGB32, QImage::Format_Indexed8, QImage::Format_Mono};
+static const char* formatNames[] = {"argb", "indexed", "mono"};
+
+//----------------------------------------------------------------------
+
+/* A frame of random pixels. Padding bits and bytes are random as well,
+ * they must not make it into the base image.
+ */
+static QImage randomFrame(const QSize& size, QImage::Format format, unsigned int& seed)
+{
+	QImage frame(size, format);
+	if (format == QImage::Format_Indexed8) {
+		QVector< QRgb > grays(256);
+		for ( int i=0 ; i<256 ; i++ ) grays[i] = qRgb(i, i, i);
+		frame.setColorTable(grays);
+	} else if (format == QImage::Format_Mono) {
+		frame.setColorCount(2);
+		frame.setColor(0, qRgb(0, 0, 0));
+		frame.setColor(1, qRgb(255, 255, 255));
+	}
+
+	for ( int row=0 ; row<size.height() ; row++ ) {
+		uchar *line = frame.scanLine(row);
+		for ( int i=0 ; i<frame.bytesPerLine() ; i++ ) {
+			seed = seed * 1103515245 + 12345;
+			line[i] = (uchar) (seed >> 16);
+		}
+	}
+
+	return frame;
+}
+
+//----------------------------------------------------------------------
+
+/* True, if both images are of the same size and format and their rows
+ * hold the same bytes, up to the padding.
+ */
+static bool sameBytes(const QImage& a, const QImage& b)
+{
+	if (a.size() != b.size() || a.format() != b.format()) return false;
+
+	int bits = a.width() * a.depth();
+	int fullBytes = bits / 8;
+	unsigned char lastMask = (unsigned char) (0xff << (8 - bits % 8));
+
+	for ( int row=0 ; row<a.height() ; row++ ) {
+		const uchar *lineA = a.constScanLine(row);
+		const uchar *lineB = b.constScanLine(row);
+		if (memcmp(lineA, lineB, fullBytes) != 0) return false;
+		if (bits % 8 != 0 && ((lineA[fullBytes] ^ lineB[fullBytes]) & lastMask)) return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compare the band parallel Composer::compose() with a single
+ *  band on a single thread
+ *
+ * The reference is Interleaver::compose(), which fills all rows at once,
+ * and BarMask::create(). Odd heights leave a short last band, odd widths
+ * and strip widths put strip edges in the middle of the bytes of
+ * monochrome frames.
+ */
+int Tests::composerBands()
+{
+	static const int widths[] = {1, 13, 37, 67};
+	static const int heights[] = {1, 7, 33, 131};
+	static const int stripWidths[] = {1, 3, 5, 8};
+	static const int threadCounts[] = {1, 2, 3, 5};
+
+	int failures = 0;
+	unsigned int seed = 2010;
+
+	for ( unsigned int f=0 ; f<sizeof(formats) / sizeof(formats[0]) ; f++ )
+		for ( unsigned int w=0 ; w<sizeof(widths) / sizeof(widths[0]) ; w++ )
+			for ( unsigned int h=0 ; h<sizeof(heights) / sizeof(heights[0]) ; h++ )
+				for ( int nrFrames=2 ; nrFrames<=3 ; nrFrames++ ) {
+					QSize size(widths[w], heights[h]);
+
+					std::vector< QImage > frameImages;
+					std::vector< QImage* > frames;
+					for ( int i=0 ; i<nrFrames ; i++ ) frameImages.push_back(randomFrame(size, formats[f], seed));
+					for ( int i=0 ; i<nrFrames ; i++ ) frames.push_back(&frameImages[i]);
+
+					for ( unsigned int s=0 ; s<sizeof(stripWidths) / sizeof(stripWidths[0]) ; s++ ) {
+						int stripWidth = stripWidths[s];
+						if (stripWidth > size.width()) continue;
+
+						Interleaver interleaver;
+						interleaver.setStripWidth(stripWidth);
+						QImage referenceBase, referenceMask;
+						bool ok = interleaver.setFrames(frames) && interleaver.compose(referenceBase);
+						ok = BarMask::create(referenceMask, size, stripWidth, nrFrames) && ok;
+
+						for ( unsigned int t=0 ; t<sizeof(threadCounts) / sizeof(threadCounts[0]) ; t++ ) {
+							Composer composer;
+							composer.setStripWidth(stripWidth);
+							composer.setThreadCount(threadCounts[t]);
+
+							QImage baseImage, barMask;
+							bool same = ok &&
+								composer.setFrames(frames) &&
+								composer.compose(baseImage, barMask) &&
+								sameBytes(baseImage, referenceBase) &&
+								sameBytes(barMask, referenceMask);
+
+							if (!same) {
+								std::cerr << "Composer::compose differs from a single band for " << formatNames[f]
+									<< " frames of " << size.width() << "x" << size.height() << ", "
+									<< nrFrames << " frames, strip width " << stripWidth << ", "
+									<< threadCounts[t] << " threads." << std::endl;
+								failures++;
+							}
+						}
+					}
+				}
+
+	return failures;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compare Composer::update() with a fresh Composer::compose()
+ *
+ * One of N frames is replaced, or the first and the last frame are
+ * swapped, and the previous results are handed to run() by setPrevious().
+ * Only the strips of the changed frames may be rewritten, and the images
+ * passed to setPrevious() must stay as they were. Bar masks narrower than
+ * a period and a strip cannot be decoded, run() composes these anew.
+ */
+int Tests::composerUpdate()
+{
+	static const int widths[] = {1, 13, 67};
+	static const int heights[] = {1, 33};
+	static const int stripWidths[] = {1, 3, 8};
+	static const int threadCounts[] = {1, 3};
+
+	int failures = 0;
+	unsigned int seed = 2011;
+
+	for ( unsigned int f=0 ; f<sizeof(formats) / sizeof(formats[0]) ; f++ )
+		for ( unsigned int w=0 ; w<sizeof(widths) / sizeof(widths[0]) ; w++ )
+			for ( unsigned int h=0 ; h<sizeof(heights) / sizeof(heights[0]) ; h++ )
+				for ( int nrFrames=2 ; nrFrames<=4 ; nrFrames++ )
+					for ( unsigned int s=0 ; s<sizeof(stripWidths) / sizeof(stripWidths[0]) ; s++ ) {
+						QSize size(widths[w], heights[h]);
+						int stripWidth = stripWidths[s];
+						if (stripWidth > size.width()) continue;
+
+						std::vector< QImage > frameImages;
+						for ( int i=0 ; i<nrFrames ; i++ ) frameImages.push_back(randomFrame(size, formats[f], seed));
+						QImage newFrame = randomFrame(size, formats[f], seed);
+
+						for ( int change=0 ; change<=nrFrames ; change++ ) {
+							/* change < nrFrames replaces that frame, else the
+							 * first and the last one are swapped
+							 */
+							std::vector< QImage* > oldFrames, newFrames;
+							std::vector< bool > changed(nrFrames, false);
+							for ( int i=0 ; i<nrFrames ; i++ ) oldFrames.push_back(&frameImages[i]);
+							newFrames = oldFrames;
+							if (change < nrFrames) {
+								newFrames[change] = &newFrame;
+								changed[change] = true;
+							} else {
+								std::swap(newFrames[0], newFrames[nrFrames - 1]);
+								changed[0] = changed[nrFrames - 1] = true;
+							}
+
+							for ( unsigned int t=0 ; t<sizeof(threadCounts) / sizeof(threadCounts[0]) ; t++ ) {
+								Composer oldComposer, freshComposer, composer;
+								oldComposer.setStripWidth(stripWidth);
+								freshComposer.setStripWidth(stripWidth);
+								composer.setStripWidth(stripWidth);
+								composer.setThreadCount(threadCounts[t]);
+
+								QImage oldBase, oldMask, freshBase, freshMask;
+								bool ok = oldComposer.setFrames(oldFrames) &&
+									oldComposer.compose(oldBase, oldMask) &&
+									freshComposer.setFrames(newFrames) &&
+									freshComposer.compose(freshBase, freshMask);
+								QImage keptBase = oldBase.copy();
+
+								ok = ok && composer.setFrames(newFrames);
+								if (ok) composer.setPrevious(oldBase, oldMask, changed);
+
+								int nrRewritten = nrFrames * stripWidth < size.width() ? (change < nrFrames ? 1 : 2) : nrFrames;
+								bool same = ok &&
+									composer.run() &&
+									composer.nrRewritten() == nrRewritten &&
+									sameBytes(composer.baseImage(), freshBase) &&
+									sameBytes(composer.barMask(), freshMask) &&
+									sameBytes(oldBase, keptBase);
+
+								if (!same) {
+									std::cerr << "Composer::update differs from Composer::compose for " << formatNames[f]
+										<< " frames of " << size.width() << "x" << size.height() << ", "
+										<< nrFrames << " frames, strip width " << stripWidth << ", "
+										<< (change < nrFrames ? "frame replaced, " : "frames swapped, ")
+										<< threadCounts[t] << " threads." << std::endl;
+									failures++;
+								}
+							}
+						}
+					}
+
+	return failures;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Check that translucent frames keep their exact pixels
+ *
+ * Premultiplying rounds the colors of translucent pixels. A translucent
+ * frame is combined with an opaque one and with an indexed one with a
+ * translucent color table, every pixel of the base image must be the one
+ * of its frame.
+ */
+int Tests::composerAlpha()
+{
+	const QSize size(37, 7);
+	const int stripWidth = 3;
+
+	unsigned int seed = 2012;
+	QImage translucent = randomFrame(size, QImage::Format_ARGB32, seed);
+	QImage opaque = randomFrame(size, QImage::Format_RGB32, seed);
+	QImage indexed = randomFrame(size, QImage::Format_Indexed8, seed);
+	QVector< QRgb > colors(256);
+	for ( int i=0 ; i<256 ; i++ ) colors[i] = qRgba(i, 255 - i, i / 2, i);
+	indexed.setColorTable(colors);
+
+	std::vector< QImage* > frames;
+	frames.push_back(&translucent);
+	frames.push_back(&opaque);
+	frames.push_back(&indexed);
+
+	int failures = 0;
+
+	Composer composer;
+	composer.setStripWidth(stripWidth);
+	QImage baseImage, barMask;
+	bool ok = composer.setFrames(frames) &&
+		composer.compose(baseImage, barMask) &&
+		baseImage.format() == QImage::Format_ARGB32;
+
+	for ( int row=0 ; ok && row<size.height() ; row++ )
+		for ( int col=0 ; ok && col<size.width() ; col++ ) {
+			const QImage *frame = frames[(col / stripWidth) % frames.size()];
+			ok = (baseImage.pixel(col, row) == frame->pixel(col, row));
+		}
+
+	if (!ok) {
+		std::cerr << "Composer::compose changes the pixels of translucent frames." << std::endl;
+		failures++;
+	}
+
+	return failures;
+}
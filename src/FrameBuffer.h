@@ -0,0 +1,48 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAMEBUFFER_H
+#define _FRAMEBUFFER_H
+
+#include <cstddef>
+
+/*! \brief A plain pixel buffer
+ *
+ * This is how the core library's plain C++ interface (e.g.
+ * Interleaver::interleave(), BarMask::fill(), BarMask::decode()) takes
+ * images, so it may be used without any QImage. Rows are stored top to
+ * bottom, bytesPerLine apart. The pixel layout depends on the function
+ * the buffer is passed to.
+ */
+struct FrameBuffer
+{
+	FrameBuffer() : bits(0), width(0), height(0), bytesPerLine(0) {}
+
+	FrameBuffer(unsigned char* bits_, int width_, int height_, int bytesPerLine_) :
+		bits(bits_), width(width_), height(height_), bytesPerLine(bytesPerLine_) {}
+
+	unsigned char* scanLine(int row) const { return bits + (size_t) row * bytesPerLine; }
+
+	unsigned char* bits;
+	int width;
+	int height;
+	int bytesPerLine;
+};
+
+#endif // _FRAMEBUFFER_H
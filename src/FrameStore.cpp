@@ -0,0 +1,144 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include "FrameStore.h"
+#include "Interleaver.h"
+#include "Trace.h"
+
+//----------------------------------------------------------------------
+
+FrameStore::FrameStore()
+{
+}
+
+//----------------------------------------------------------------------
+
+/* Deleting the files unmaps and removes them. */
+FrameStore::~FrameStore()
+{
+	purge();
+	m_shared.clear();
+	qDeleteAll(m_files);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Move a frame to a memory mapped scratch file
+ *
+ * This may be called from several threads at once.
+ *
+ * \param image The frame
+ *
+ * \return The frame in Interleaver::canonicalFormat() on top of the
+ *  mapping, or a null image if the frame could not be written or mapped.
+ *  The mapping stays valid until the frame is released.
+ */
+QImage FrameStore::store(const QImage& image)
+{
+	if (image.isNull()) return QImage();
+
+	TraceSpan span("storeFrame");
+	span.setBytes(image.byteCount());
+
+	QImage converted = image;
+	QImage::Format canonical = Interleaver::canonicalFormat(image);
+	if (converted.format() != canonical)
+		converted = image.convertToFormat(canonical);
+
+	QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + "/animbar_frame");
+	qint64 size = (qint64) converted.bytesPerLine() * converted.height();
+
+	uchar *map = NULL;
+	if (file->open() &&
+		file->write((const char*) converted.constBits(), size) == size &&
+		file->flush())
+		map = file->map(0, size);
+
+	if (!map) {
+		std::cerr << "FrameStore::store - Failed to map scratch file." << std::endl;
+		delete file;
+		return QImage();
+	}
+
+	/* Writing to a frame must detach it rather than change the file, so
+	 * the image is read-only. Setting the color table of a read-only image
+	 * would copy the pixels, though. Frames with a color table are
+	 * writable instead and we keep a shallow copy of them, which makes
+	 * QImage detach them on writes just as well.
+	 */
+	QImage mapped;
+	if (converted.colorCount() > 0) {
+		mapped = QImage(
+			map,
+			converted.width(),
+			converted.height(),
+			converted.bytesPerLine(),
+			canonical);
+		mapped.setColorTable(converted.colorTable());
+	} else {
+		mapped = QImage(
+			(const uchar*) map,
+			converted.width(),
+			converted.height(),
+			converted.bytesPerLine(),
+			canonical);
+	}
+
+	QMutexLocker locker(&m_mutex);
+	m_files.insert(map, file);
+	if (converted.colorCount() > 0) m_shared.insert(map, mapped);
+
+	return mapped;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Release a frame returned by store()
+ *
+ * Images not returned by store() are ignored. The mapping is only removed
+ * by the next purge(), so shallow copies of the frame, e.g. in a running
+ * Composer, stay valid until then.
+ */
+void FrameStore::release(const QImage& image)
+{
+	QMutexLocker locker(&m_mutex);
+
+	QTemporaryFile *file = m_files.take(image.constBits());
+	if (file) m_released.append(file);
+	m_shared.remove(image.constBits());
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Unmap and remove the files of all released frames
+ *
+ * No copy of a released frame must be used afterwards.
+ */
+void FrameStore::purge()
+{
+	QMutexLocker locker(&m_mutex);
+
+	qDeleteAll(m_released);
+	m_released.clear();
+}
@@ -0,0 +1,63 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAMESTORE_H
+#define _FRAMESTORE_H
+
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QTemporaryFile>
+
+/*! \brief Keeps decoded frames in memory mapped scratch files
+ *
+ * A frame passed to store() is written to a temporary file in the format
+ * the interleaver reads, see Interleaver::canonicalFormat(), and handed
+ * back as a QImage on top of a memory mapping of that file. Hence, the operating
+ * system may page frames in and out as needed and we are able to build
+ * animations from frames that do not fit into memory all at once. As the
+ * frames are already in the interleaver's format, it reads their scanlines
+ * straight from the mapping.
+ *
+ * Every frame gets a file of its own: on some platforms a file can't be
+ * mapped beyond the size it had when it was first mapped.
+ */
+class FrameStore
+{
+public:
+	FrameStore();
+	~FrameStore();
+
+	/* documented in source code */
+	QImage store(const QImage&);
+	void release(const QImage&);
+	void purge();
+
+private:
+	/* the mapped files by the address of their mapping */
+	QMap< const uchar*, QTemporaryFile* > m_files;
+	/* shallow copies of the frames with a color table, see store() */
+	QMap< const uchar*, QImage > m_shared;
+	/* the files of released frames, see release() */
+	QList< QTemporaryFile* > m_released;
+	QMutex m_mutex;
+};
+
+#endif // _FRAMESTORE_H
@@ -0,0 +1,200 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageIOHandler>
+#include <QImageReader>
+
+#include "ImageLoader.h"
+#include "Interleaver.h"
+#include "Trace.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Decode an image file, normalize it and create its thumbnail
+ *
+ * \param fileName The image file
+ *
+ * \return The decoded image and its thumbnail. On failure, the image is
+ *  NULL. No thumbnail is created for a thumbnail height of zero. With a
+ *  ThumbnailCache, the image may be null, see defer().
+ */
+LoadedImage ImageLoader::operator()(const QString& fileName) const
+{
+	LoadedImage result;
+	result.fileName = fileName;
+
+	if (defer(result)) return result;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	TraceSpan span("decode");
+	if (Trace::isEnabled()) span.setBytes(QFileInfo(fileName).size());
+
+	QImage *img = new QImage(fileName);
+	if (img->isNull()) {
+		delete img;
+		return result;
+	}
+
+	result.decodeTime = timer.elapsed();
+
+	finish(img, result);
+
+	if (m_cache) m_cache->insert(fileName, m_thumbnailHeight, result.thumbnail, result.size);
+
+	return result;
+}
+
+//----------------------------------------------------------------------
+
+/* Create the thumbnail of result.fileName without decoding the full image,
+ * from the cache or by a downscaled read. The image is left null then.
+ * Returns false if the image has to be decoded.
+ */
+bool ImageLoader::defer(LoadedImage& result) const
+{
+	if (!m_cache || m_thumbnailHeight <= 0) return false;
+
+	TraceSpan span("thumbnail");
+
+	QElapsedTimer timer;
+	timer.start();
+
+	QSize size;
+	QImage thumbnail = m_cache->find(result.fileName, m_thumbnailHeight, size);
+
+	if (thumbnail.isNull()) {
+		QImageReader reader(result.fileName);
+		size = reader.size();
+		if (!size.isValid() || size.isEmpty()) return false;
+
+		/* other formats decode the full image and scale it down */
+		if (!reader.supportsOption(QImageIOHandler::ScaledSize)) return false;
+
+		int width = qMax(1, size.width() * m_thumbnailHeight / size.height());
+		reader.setScaledSize(QSize(width, m_thumbnailHeight));
+		if (!reader.read(&thumbnail)) return false;
+
+		m_cache->insert(result.fileName, m_thumbnailHeight, thumbnail, size);
+	}
+
+	result.image = new QImage();
+	result.size = size;
+	result.thumbnail = thumbnail;
+	result.decodeTime = timer.elapsed();
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Decode a frame of an SVG animation, normalize it and create its
+ *  thumbnail
+ *
+ * See operator()(const QString&), the frame's name is used as file name.
+ * With a ThumbnailCache, only the thumbnail is created and the image is
+ * left null. Frames are no files, so the cache itself is not used.
+ */
+LoadedImage ImageLoader::operator()(const SvgFrame& frame) const
+{
+	LoadedImage result;
+	result.fileName = frame.name;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	if (m_cache && m_thumbnailHeight > 0 && !frame.size.isEmpty()) {
+		TraceSpan span("thumbnail");
+		span.setBytes(frame.data.size());
+
+		/* formats that cannot decode downscaled are scaled by the reader,
+		 * the full image is dropped right away then.
+		 */
+		QByteArray data = QByteArray::fromBase64(frame.data);
+		QBuffer buffer(&data);
+		QImageReader reader(&buffer);
+		int width = qMax(1, frame.size.width() * m_thumbnailHeight / frame.size.height());
+		reader.setScaledSize(QSize(width, m_thumbnailHeight));
+		if (!reader.read(&result.thumbnail)) return result;
+
+		result.image = new QImage();
+		result.size = frame.size;
+		result.decodeTime = timer.elapsed();
+
+		return result;
+	}
+
+	TraceSpan span("decode");
+	span.setBytes(frame.data.size());
+
+	QImage *img = new QImage(frame.decode());
+	if (img->isNull()) {
+		delete img;
+		return result;
+	}
+
+	result.decodeTime = timer.elapsed();
+
+	finish(img, result);
+
+	return result;
+}
+
+//----------------------------------------------------------------------
+
+/* The part common to all sources: create the thumbnail of the decoded
+ * image img, normalize it and move it to the store. result takes
+ * ownership of img.
+ */
+void ImageLoader::finish(QImage* img, LoadedImage& result) const
+{
+	QElapsedTimer timer;
+
+	/* create thumbnail. Do not use Qt::FastTransformation, it 
+	 * displays resulting baseImages after scaling worong (e.g.
+	 * only one of the input images.
+	 */
+	if (m_thumbnailHeight > 0) {
+		TraceSpan span("thumbnail");
+		result.thumbnail = img->scaledToHeight(m_thumbnailHeight, Qt::SmoothTransformation);
+	}
+
+	/* bring the image into the layout the interleaver copies from */
+	timer.start();
+	{
+		TraceSpan span("normalize");
+		QImage::Format canonical = Interleaver::canonicalFormat(*img);
+		if (img->format() != canonical) *img = img->convertToFormat(canonical);
+		span.setBytes(img->byteCount());
+	}
+	result.normalizeTime = timer.elapsed();
+
+	/* replace the decoded pixels by the mapped ones, if we can */
+	if (m_store) {
+		QImage mapped = m_store->store(*img);
+		if (!mapped.isNull()) *img = mapped;
+	}
+
+	result.image = img;
+	result.size = img->size();
+}
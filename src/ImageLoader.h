@@ -0,0 +1,95 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IMAGELOADER_H
+#define _IMAGELOADER_H
+
+#include <QImage>
+#include <QString>
+
+#include "FrameStore.h"
+#include "SvgReader.h"
+#include "ThumbnailCache.h"
+
+/*! \brief An input image decoded by ImageLoader */
+struct LoadedImage
+{
+	LoadedImage() : image(NULL), decodeTime(0), normalizeTime(0) {}
+
+	QString fileName;
+	/*! The decoded image in Interleaver::canonicalFormat(), NULL if
+	 * decoding failed. A null image if decoding has been deferred, see
+	 * ImageLoader. The receiver takes ownership.
+	 */
+	QImage *image;
+	/*! Size of the image, also if decoding has been deferred */
+	QSize size;
+	QImage thumbnail;
+
+	/*! Milliseconds spent on decoding and on the conversion to
+	 * Interleaver::canonicalFormat()
+	 */
+	qint64 decodeTime;
+	qint64 normalizeTime;
+};
+
+/*! \brief Decodes an input image and creates its thumbnail
+ *
+ * This is a function object for QtConcurrent::mapped(), so a list of files
+ * is decoded in parallel on the global thread pool. It only deals with
+ * QImages, the pixmaps for the list icons must be created in the GUI
+ * thread. If a FrameStore is given, the decoded images are moved there.
+ * Frames of an SVG animation (see SvgReader) are decoded the same way.
+ *
+ * The images are normalized to Interleaver::canonicalFormat() right here,
+ * once per image, so computing an animation only copies memory, no matter
+ * how often it is computed.
+ *
+ * If a ThumbnailCache is given, image files are only decoded if we must,
+ * the image is left null then and has to be loaded again once its pixels
+ * are needed. That is, if the thumbnail is in the cache or the image
+ * format decodes downscaled images directly (e.g. JPEG), see
+ * QImageReader::setScaledSize(). Thumbnails made otherwise are added to
+ * the cache. With a ThumbnailCache, frames of an SVG animation are only
+ * decoded to make their thumbnails and are left null as well.
+ */
+class ImageLoader
+{
+public:
+	typedef LoadedImage result_type;
+
+	ImageLoader(int thumbnailHeight, FrameStore *store = NULL, const ThumbnailCache *cache = NULL) :
+		m_thumbnailHeight(thumbnailHeight),
+		m_store(store),
+		m_cache(cache) {}
+
+	/* documented in source code */
+	LoadedImage operator()(const QString&) const;
+	LoadedImage operator()(const SvgFrame&) const;
+
+private:
+	bool defer(LoadedImage&) const;
+	void finish(QImage*, LoadedImage&) const;
+
+	int m_thumbnailHeight;
+	FrameStore *m_store;
+	const ThumbnailCache *m_cache;
+};
+
+#endif // _IMAGELOADER_H
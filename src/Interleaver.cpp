@@ -0,0 +1,342 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <iostream>
+
+#include "Interleaver.h"
+
+//----------------------------------------------------------------------
+
+Interleaver::Interleaver() :
+	m_stripWidth(1),
+	m_nrConverted(0),
+	m_baseFormat(format)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the input frames
+ *
+ * All frames must be of same size. Frames that are not in the base image's
+ * format are converted here, so the composition itself only needs to copy
+ * memory. Frames loaded by ImageLoader are already in their
+ * canonicalFormat().
+ *
+ * \param frames Input frames in the order their strips appear in the base
+ *  image
+ * \param reduceDepth If false, the base image is in full color even if the
+ *  frames would allow for less bits per pixel.
+ *
+ * \return False, if there are no frames or they differ in size.
+ */
+bool Interleaver::setFrames(const std::vector< QImage* >& frames, bool reduceDepth)
+{
+	m_frames.clear();
+	m_nrConverted = 0;
+	m_baseFormat = format;
+	m_colorTable.clear();
+
+	if (frames.empty()) return false;
+
+	QSize size0 = frames[0]->size();
+	for ( unsigned int i=0 ; i<frames.size() ; i++ )
+		if (frames[i]->size() != size0) {
+			std::cerr << "Interleaver::setFrames - Frames differ in size." << std::endl;
+			return false;
+		}
+
+	/* premultiplying would round the colors of translucent pixels, so
+	 * frames with alpha keep it straight, unless they come premultiplied
+	 * already.
+	 */
+	for ( unsigned int i=0 ; i<frames.size() ; i++ )
+		if (frames[i]->hasAlphaChannel() && frames[i]->format() != format)
+			m_baseFormat = QImage::Format_ARGB32;
+
+	/* we may keep one bit or one byte per pixel, if all frames agree on
+	 * it and on their colors.
+	 */
+	if (reduceDepth) {
+		QImage::Format reduced = canonicalFormat(*frames[0]);
+		if (reduced != QImage::Format_Mono && reduced != QImage::Format_Indexed8) reduced = m_baseFormat;
+		for ( unsigned int i=1 ; i<frames.size() && reduced != m_baseFormat ; i++ )
+			if (canonicalFormat(*frames[i]) != reduced ||
+				frames[i]->colorTable() != frames[0]->colorTable())
+				reduced = m_baseFormat;
+
+		if (reduced != m_baseFormat) m_colorTable = frames[0]->colorTable();
+		m_baseFormat = reduced;
+	}
+
+	m_frames.resize(frames.size());
+	for ( unsigned int i=0 ; i<frames.size() ; i++ ) {
+		if (frames[i]->format() == m_baseFormat) m_frames[i] = *frames[i];
+		else {
+			m_frames[i] = frames[i]->convertToFormat(m_baseFormat);
+			m_nrConverted++;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief The format an image is best kept in
+ *
+ * Monochrome images are kept in QImage::Format_Mono, indexed ones in
+ * QImage::Format_Indexed8, Qt decodes grayscale images to the latter.
+ * Images with an alpha channel are kept in QImage::Format_ARGB32, so their
+ * colors are not rounded by premultiplication, unless they are in format
+ * already. All others are kept in format.
+ */
+QImage::Format Interleaver::canonicalFormat(const QImage& image)
+{
+	switch (image.format()) {
+	case QImage::Format_Mono:
+	case QImage::Format_MonoLSB:
+		return QImage::Format_Mono;
+	case QImage::Format_Indexed8:
+		return QImage::Format_Indexed8;
+	case format:
+		return format;
+	default:
+		break;
+	}
+
+	if (image.hasAlphaChannel()) return QImage::Format_ARGB32;
+
+	return format;
+}
+
+//----------------------------------------------------------------------
+
+void Interleaver::setStripWidth(int stripWidth)
+{
+	m_stripWidth = (stripWidth > 0) ? stripWidth : 1;
+}
+
+//----------------------------------------------------------------------
+
+QSize Interleaver::size() const
+{
+	if (m_frames.empty()) return QSize();
+	return m_frames[0].size();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compute the complete base image
+ *
+ * \param result (out) The base image, reallocated in baseFormat()
+ *
+ * \return False, if no frames have been set.
+ */
+bool Interleaver::compose(QImage& result) const
+{
+	if (m_frames.empty()) return false;
+
+	result = QImage(size(), m_baseFormat);
+	if (result.isNull()) return false;
+	if (!m_colorTable.isEmpty()) result.setColorTable(m_colorTable);
+
+	composeRows(result.bits(), result.bytesPerLine(), 0, result.height());
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Compute the rows [rowBegin, rowEnd) of the base image
+ *
+ * The destination buffer must be of the frames' size and in baseFormat(). As
+ * every row only depends on the same row of the input frames, disjoint row
+ * ranges may be computed independently, also from different threads. This
+ * is why we take the raw pixel buffer of the base image: QImage::scanLine()
+ * is not safe to be called concurrently.
+ *
+ * \param bits Where to write row rowBegin of the base image, e.g.
+ *  QImage::bits() plus rowBegin * bytesPerLine, or a buffer of just these
+ *  rows
+ * \param bytesPerLine Bytes per line of the destination
+ * \param rowBegin First row to compute
+ * \param rowEnd One past the last row to compute
+ * \param phases If given, only the strips of the frames i with phases[i]
+ *  set are written, the other columns of the destination are left as they
+ *  are. This updates a base image after frames have been reordered or
+ *  replaced, see Composer::update().
+ */
+void Interleaver::composeRows(
+	unsigned char* bits,
+	int bytesPerLine,
+	int rowBegin,
+	int rowEnd,
+	const std::vector< bool >* phases) const
+{
+	if (m_frames.empty()) return;
+
+	unsigned int nrFrames = m_frames.size();
+	int width = size().width();
+	int bytesPerPixel = m_frames[0].depth() / 8;
+
+	std::vector< const unsigned char* > srcRows(nrFrames);
+
+	for ( int row=rowBegin ; row<rowEnd ; row++ ) {
+		unsigned char *dstRow = bits + (size_t) (row - rowBegin) * bytesPerLine;
+		for ( unsigned int i=0 ; i<nrFrames ; i++ )
+			srcRows[i] = m_frames[i].constScanLine(row);
+		if (m_baseFormat == QImage::Format_Mono)
+			interleaveBits(&srcRows[0], nrFrames, dstRow, width, m_stripWidth, phases);
+		else
+			interleaveRow(&srcRows[0], nrFrames, dstRow, width, m_stripWidth, bytesPerPixel, phases);
+	}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Interleave plain frame buffers
+ *
+ * This is the plain C++ counterpart of compose(): all buffers must be of
+ * the same width and height and use bytesPerPixel bytes per pixel.
+ *
+ * \param frames The input frames
+ * \param nrFrames Number of input frames
+ * \param result The base image to fill
+ * \param stripWidth Strip width in pixels
+ * \param bytesPerPixel Bytes per pixel of all buffers
+ *
+ * \return False, if the buffers do not fit together.
+ */
+bool Interleaver::interleave(
+	const FrameBuffer* frames,
+	unsigned int nrFrames,
+	const FrameBuffer& result,
+	int stripWidth,
+	int bytesPerPixel)
+{
+	if (nrFrames == 0 || stripWidth <= 0 || bytesPerPixel <= 0) return false;
+
+	for ( unsigned int i=0 ; i<nrFrames ; i++ )
+		if (frames[i].width != result.width || frames[i].height != result.height)
+			return false;
+
+	std::vector< const unsigned char* > srcRows(nrFrames);
+
+	for ( int row=0 ; row<result.height ; row++ ) {
+		for ( unsigned int i=0 ; i<nrFrames ; i++ )
+			srcRows[i] = frames[i].scanLine(row);
+		interleaveRow(&srcRows[0], nrFrames, result.scanLine(row), result.width, stripWidth, bytesPerPixel);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Interleave a single scanline
+ *
+ * Column col of the destination row is taken from the frame with index
+ * (col / stripWidth) % nrFrames. Each strip is copied as one block.
+ *
+ * \param srcRows Pointers to the same scanline of every frame
+ * \param nrFrames Number of frames
+ * \param dstRow Destination scanline
+ * \param width Width of the scanlines in pixels
+ * \param stripWidth Strip width in pixels
+ * \param bytesPerPixel Bytes per pixel of source and destination
+ * \param phases If given, only the strips of the frames i with phases[i]
+ *  set are copied
+ */
+void Interleaver::interleaveRow(
+	const unsigned char* const* srcRows,
+	unsigned int nrFrames,
+	unsigned char* dstRow,
+	int width,
+	int stripWidth,
+	int bytesPerPixel,
+	const std::vector< bool >* phases)
+{
+	unsigned int i = 0;
+	for ( int col=0 ; col<width ; col+=stripWidth ) {
+		if (!phases || (*phases)[i]) {
+			int n = (col + stripWidth <= width) ? stripWidth : width - col;
+			size_t offset = (size_t) col * bytesPerPixel;
+			memcpy(dstRow + offset, srcRows[i] + offset, (size_t) n * bytesPerPixel);
+		}
+		if (++i == nrFrames) i = 0;
+	}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Interleave a single scanline of monochrome frames
+ *
+ * As interleaveRow(), but for QImage::Format_Mono scanlines. Strips start
+ * and end within bytes, so the bytes at the ends of a strip are merged bit
+ * by bit and the bytes in between are copied as one block. The padding
+ * bits of the last byte are cleared.
+ *
+ * \param srcRows Pointers to the same scanline of every frame
+ * \param nrFrames Number of frames
+ * \param dstRow Destination scanline
+ * \param width Width of the scanlines in pixels
+ * \param stripWidth Strip width in pixels
+ * \param phases If given, only the strips of the frames i with phases[i]
+ *  set are copied
+ */
+void Interleaver::interleaveBits(
+	const unsigned char* const* srcRows,
+	unsigned int nrFrames,
+	unsigned char* dstRow,
+	int width,
+	int stripWidth,
+	const std::vector< bool >* phases)
+{
+	unsigned int i = 0;
+	for ( int col=0 ; col<width ; col+=stripWidth ) {
+		if (phases && !(*phases)[i]) {
+			if (++i == nrFrames) i = 0;
+			continue;
+		}
+
+		int to = qMin(col + stripWidth, width);
+		const unsigned char *src = srcRows[i];
+
+		int firstByte = col >> 3;
+		int lastByte = (to - 1) >> 3;
+		unsigned char firstMask = 0xff >> (col & 7);
+		unsigned char lastMask = 0xff << (7 - ((to - 1) & 7));
+
+		if (firstByte == lastByte) {
+			unsigned char m = firstMask & lastMask;
+			dstRow[firstByte] = (dstRow[firstByte] & ~m) | (src[firstByte] & m);
+		} else {
+			dstRow[firstByte] = (dstRow[firstByte] & ~firstMask) | (src[firstByte] & firstMask);
+			if (lastByte - firstByte > 1)
+				memcpy(dstRow + firstByte + 1, src + firstByte + 1, lastByte - firstByte - 1);
+			dstRow[lastByte] = (dstRow[lastByte] & ~lastMask) | (src[lastByte] & lastMask);
+		}
+
+		if (++i == nrFrames) i = 0;
+	}
+
+	if (width & 7) dstRow[width >> 3] &= 0xff << (8 - (width & 7));
+}
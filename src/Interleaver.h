@@ -0,0 +1,103 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _INTERLEAVER_H
+#define _INTERLEAVER_H
+
+#include <vector>
+
+#include <QImage>
+#include <QVector>
+
+#include "FrameBuffer.h"
+
+/*! \brief Builds the base image from a set of input frames
+ *
+ * The base image is made of strips of stripWidth columns, taken one after
+ * another from the input frames. Instead of working column by column, we
+ * walk the base image row by row and copy every strip run of a scanline as
+ * one block. Input frames are converted to the base image's format once,
+ * when they are handed over to setFrames().
+ *
+ * If all frames are monochrome or all are indexed (which includes
+ * grayscale), with one color table, the base image keeps that depth: one
+ * bit or one byte per pixel instead of four. Otherwise, the base image is
+ * in full color: in QImage::Format_ARGB32 if any frame has straight alpha,
+ * which the base image keeps exactly, else in format.
+ */
+class Interleaver
+{
+public:
+	Interleaver();
+
+	/* documented in source code */
+	bool setFrames(const std::vector< QImage* >&, bool = true);
+	void setStripWidth(int);
+
+	int stripWidth() const { return m_stripWidth; }
+	int nrFrames() const { return m_frames.size(); }
+	/*! Number of frames setFrames() had to convert to baseFormat() */
+	int nrConverted() const { return m_nrConverted; }
+	QSize size() const;
+
+	/*! The format of the base image, see setFrames() */
+	QImage::Format baseFormat() const { return m_baseFormat; }
+	/*! The color table of the base image, empty in full color */
+	const QVector< QRgb >& colorTable() const { return m_colorTable; }
+
+	/* documented in source code */
+	bool compose(QImage&) const;
+	void composeRows(unsigned char*, int, int, int, const std::vector< bool >* = NULL) const;
+
+	static bool interleave(const FrameBuffer*, unsigned int, const FrameBuffer&, int, int);
+	static void interleaveRow(
+		const unsigned char* const*,
+		unsigned int,
+		unsigned char*,
+		int,
+		int,
+		int,
+		const std::vector< bool >* = NULL);
+	static void interleaveBits(
+		const unsigned char* const*,
+		unsigned int,
+		unsigned char*,
+		int,
+		int,
+		const std::vector< bool >* = NULL);
+
+	static QImage::Format canonicalFormat(const QImage&);
+
+	/*! The format of full color base images, all frames are converted to it
+	 * unless the depth can be reduced or a frame has straight alpha.
+	 */
+	static const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+
+private:
+	/* the input frames in m_baseFormat, shallow copies where no
+	 * conversion was needed.
+	 */
+	std::vector< QImage > m_frames;
+	int m_stripWidth;
+	int m_nrConverted;
+	QImage::Format m_baseFormat;
+	QVector< QRgb > m_colorTable;
+};
+
+#endif // _INTERLEAVER_H
@@ -17,9 +17,19 @@
  * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+
 #include "MainWindow.h"
+#include "Composer.h"
+#include "TiledImageView.h"
+#include "SvgWriter.h"
+#include "SvgReader.h"
+#include "BarMask.h"
+#include "Trace.h"
 
 //----------------------------------------------------------------------
 
@@ -29,9 +39,20 @@
 QDataStream &operator<<( QDataStream &out, const QImage* & ) { return out; }
 QDataStream &operator>>( QDataStream &in, QImage* & ) { return in; }
 
+/* Besides the image, list items hold the image's size and its file name.
+ * The latter is needed to decode the image later on, see decodeImages().
+ * Frames of an SVG animation keep their encoded image file instead, until
+ * they have been decoded.
+ */
+static const int SizeRole = Qt::UserRole + 1;
+static const int FileNameRole = Qt::UserRole + 2;
+static const int SvgDataRole = Qt::UserRole + 3;
+
 //----------------------------------------------------------------------
 
-MainWindow::MainWindow() : QMainWindow()
+MainWindow::MainWindow() :
+	QMainWindow(),
+	thumbnailCache(QDesktopServices::storageLocation(QDesktopServices::CacheLocation) + "/thumbnails")
 {	
 	_init();
 	
@@ -49,6 +70,10 @@ MainWindow::MainWindow() : QMainWindow()
 	 */
 	qRegisterMetaType<QImage*>("QImage*");
 	qRegisterMetaTypeStreamOperators<QImage*>("QImage*");
+	
+	connect(&computeWatcher, SIGNAL(finished()), this, SLOT(computeFinished()));
+	connect(&openWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(openImageReady()));
+	connect(&openWatcher, SIGNAL(finished()), this, SLOT(openFinished()));
 }
 
 //----------------------------------------------------------------------
@@ -63,16 +88,62 @@ void MainWindow::_init()
 	/* strip width in pixels, three seems to be a good value */
 	stripWidth = 3;
 	
+	/* one second per frame */
+	animDuration = 0.;
+	
 	/* Initial zoom factor is 1, e.g. no zoom */
 	zoomFactor = 1.;
+	
+	/* compute on as many threads as we have cores */
+	threadCount = 0;
+	
+	/* keep a few animations of typical size */
+	resultCacheSize = 256;
+	resultCache.setMaxBytes((qint64) resultCacheSize * 1024 * 1024);
+	
+	/* write indented SVG files with the bar mask as image */
+	compactSvg = false;
+	compactSvgAction = NULL;
+	
+	/* keep decoded frames in memory */
+	framesOnDisk = false;
+	framesOnDiskAction = NULL;
+	
+	/* Qt's default PNG compression */
+	pngCompression = PngWriter::Default;
+	pngCompressionActions = NULL;
+	
+	/* no images being loaded */
+	openProgress = NULL;
+	openNext = 0;
+	openDecodeTime = 0;
+	openNormalizeTime = 0;
+	
+	/* no computation running */
+	composer = NULL;
+	computeProgress = NULL;
+	computeCancel = NULL;
 }
 
 //----------------------------------------------------------------------
 
 MainWindow::~MainWindow()
 {
+	/* images still being loaded are not in the list yet */
+	if (openProgress) {
+		openWatcher.waitForFinished();
+		QFuture< LoadedImage > future = openWatcher.future();
+		for ( int i=openNext ; i<future.resultCount() ; i++ )
+			deleteImage(future.resultAt(i).image);
+	}
+	
+	if (composer) {
+		composer->cancel();
+		computeWatcher.waitForFinished();
+	}
+	
 	/* Iterate over all list items and delete the image pointer */
-	for ( int i=0 ; i < imageList->count() ; i++ ) delete getImage(i);
+	for ( int i=0 ; i < imageList->count() ; i++ ) deleteImage(getImage(i));
 }
 
 //----------------------------------------------------------------------
@@ -129,7 +200,7 @@ bool MainWindow::setupUI()
 	vLayoutR->getContentsMargins(&left, &top, &right, &bottom);
 	vLayoutR->setContentsMargins(left/2, top, right, bottom);
 	
-	QScrollArea *scrollArea = new QScrollArea;
+	scrollArea = new QScrollArea;
 	scrollArea->setBackgroundRole(QPalette::Dark);
 	scrollArea->setAlignment(Qt::AlignCenter);
 	vLayoutR->addWidget(scrollArea);
@@ -175,6 +246,12 @@ bool MainWindow::setupUI()
 
 	scrollArea->setWidget(imageLabel);
 	
+	/* the view replaces imageLabel in scrollArea once we have computed
+	 * an animation, see computeFinished().
+	 */
+	imageView = new TiledImageView(rightSide);
+	imageView->hide();
+	
 	slider = new QSlider(Qt::Horizontal, rightSide);
 	slider->setTickInterval(1);
 	slider->setTickPosition(QSlider::NoTicks);
@@ -220,6 +297,11 @@ bool MainWindow::setupMenus()
     connect(action, SIGNAL(triggered()), this, SLOT(openFile()));
 	fileMenu->addAction(action);
 	
+	action = new QAction(tr("Open A&nimation ..."), this);
+    action->setStatusTip(tr("Open the frames of an animation saved to an SVG file"));
+    connect(action, SIGNAL(triggered()), this, SLOT(openAnimation()));
+	fileMenu->addAction(action);
+	
 	fileMenu->addSeparator();
 	
 	action = new QAction(tr("&Save Base Image ..."), this);
@@ -269,6 +351,53 @@ bool MainWindow::setupMenus()
     connect(action, SIGNAL(triggered()), this, SLOT(compute()));
 	editMenu->addAction(action);
 	
+	editMenu->addSeparator();
+	
+	action = new QAction(tr("Number of &Threads ..."), this);
+    action->setStatusTip(tr("Set the number of threads to compute the animation on"));
+    connect(action, SIGNAL(triggered()), this, SLOT(setThreadCount()));
+	editMenu->addAction(action);
+	
+	action = new QAction(tr("Result &Cache Size ..."), this);
+    action->setStatusTip(tr("Set the memory kept for recently computed animations, so computing them again is instant"));
+    connect(action, SIGNAL(triggered()), this, SLOT(setResultCacheSize()));
+	editMenu->addAction(action);
+	
+	compactSvgAction = new QAction(tr("Compact &SVG Files"), this);
+	compactSvgAction->setCheckable(true);
+    compactSvgAction->setStatusTip(tr("Save and export smaller SVG files, with the bar mask as pattern and without formatting"));
+    connect(compactSvgAction, SIGNAL(toggled(bool)), this, SLOT(setCompactSvg(bool)));
+	editMenu->addAction(compactSvgAction);
+	
+	framesOnDiskAction = new QAction(tr("Keep Frames on &Disk"), this);
+	framesOnDiskAction->setCheckable(true);
+    framesOnDiskAction->setStatusTip(tr("Keep images opened from now on in memory mapped scratch files, for animations larger than memory"));
+    connect(framesOnDiskAction, SIGNAL(toggled(bool)), this, SLOT(setFramesOnDisk(bool)));
+	editMenu->addAction(framesOnDiskAction);
+	
+	QMenu *pngMenu = editMenu->addMenu(tr("&PNG Compression"));
+	pngCompressionActions = new QActionGroup(this);
+	
+	action = new QAction(tr("&Fast"), pngCompressionActions);
+	action->setCheckable(true);
+	action->setData((int) PngWriter::Fast);
+    action->setStatusTip(tr("Save PNG images fast, but larger"));
+	pngMenu->addAction(action);
+	
+	action = new QAction(tr("&Default"), pngCompressionActions);
+	action->setCheckable(true);
+	action->setData((int) PngWriter::Default);
+    action->setStatusTip(tr("Save PNG images with Qt's default compression"));
+	pngMenu->addAction(action);
+	
+	action = new QAction(tr("&Small"), pngCompressionActions);
+	action->setCheckable(true);
+	action->setData((int) PngWriter::Small);
+    action->setStatusTip(tr("Save PNG images small, but slowly"));
+	pngMenu->addAction(action);
+	
+    connect(pngCompressionActions, SIGNAL(triggered(QAction*)), this, SLOT(setPngCompression(QAction*)));
+	
 	/**
 	 * view menu
 	 **/
@@ -324,6 +453,21 @@ bool MainWindow::loadSettings()
 	QVariant winPosV = settings.value("winPos");
 	if (winPosV.isValid()) move(winPosV.toPoint());
 	
+	threadCount = settings.value("threadCount", 0).toInt();
+	
+	resultCacheSize = settings.value("resultCacheSize", 256).toInt();
+	resultCache.setMaxBytes((qint64) resultCacheSize * 1024 * 1024);
+	
+	compactSvg = settings.value("compactSvg", false).toBool();
+	compactSvgAction->setChecked(compactSvg);
+	
+	framesOnDisk = settings.value("framesOnDisk", false).toBool();
+	framesOnDiskAction->setChecked(framesOnDisk);
+	
+	pngCompression = PngWriter::fromString(settings.value("pngCompression", "default").toString());
+	foreach (QAction *action, pngCompressionActions->actions())
+		action->setChecked(action->data().toInt() == (int) pngCompression);
+	
 	return true;
 }
 
@@ -334,6 +478,11 @@ bool MainWindow::saveSettings()
 	QSettings settings("mnim.org", "animbar");
 	settings.setValue("winPos", pos());
 	settings.setValue("winSize", size());
+	settings.setValue("threadCount", threadCount);
+	settings.setValue("resultCacheSize", resultCacheSize);
+	settings.setValue("compactSvg", compactSvg);
+	settings.setValue("framesOnDisk", framesOnDisk);
+	settings.setValue("pngCompression", PngWriter::toString(pngCompression));
 	
 	return true;
 }
@@ -368,6 +517,139 @@ QImage* MainWindow::getImage(int idx)
 
 //----------------------------------------------------------------------
 
+/*! \brief Size of an input image, also if it has not been decoded yet */
+QSize MainWindow::getImageSize(int idx)
+{
+	return imageList->item(idx)->data(SizeRole).toSize();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Delete an input image
+ *
+ * Images kept in frameStore are released there, too. Their mappings are
+ * only removed once no computation might read them anymore.
+ */
+void MainWindow::deleteImage(QImage *img)
+{
+	if (!img) return;
+	
+	frameStore.release(*img);
+	delete img;
+	
+	if (!composer) frameStore.purge();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Decode the images of imgs that have been opened without
+ *
+ * Images whose thumbnails came from the cache or from a downscaled read
+ * are left null when opened, as are the frames of opened animations, see
+ * ImageLoader. Here we decode them in the
+ * background, while a modal progress dialog keeps the user from changing
+ * the image list. Decoded images are kept, so the list items drop the
+ * encoded frames of animations afterwards.
+ *
+ * \return False, if decoding has been canceled or an image could not be
+ *  decoded anymore. The images decoded so far are kept.
+ */
+bool MainWindow::decodeImages(const std::vector< QImage* >& imgs)
+{
+	QStringList files;
+	QList< SvgFrame > frames;
+	std::vector< QImage* > pendingFiles, pendingFrames;
+	QList< QSize > fileSizes, frameSizes;
+	QList< QListWidgetItem* > frameItems;
+	for ( int i=0 ; i<imageList->count() ; i++ ) {
+		QImage *img = getImage(i);
+		if (!img->isNull() || std::find(imgs.begin(), imgs.end(), img) == imgs.end()) continue;
+		
+		QListWidgetItem *li = imageList->item(i);
+		QByteArray data = li->data(SvgDataRole).toByteArray();
+		if (data.isEmpty()) {
+			files << li->data(FileNameRole).toString();
+			pendingFiles.push_back(img);
+			fileSizes << getImageSize(i);
+		} else {
+			SvgFrame frame;
+			frame.name = li->data(FileNameRole).toString();
+			frame.size = getImageSize(i);
+			frame.data = data;
+			frames << frame;
+			pendingFrames.push_back(img);
+			frameSizes << getImageSize(i);
+			frameItems << li;
+		}
+	}
+	
+	ImageLoader loader(0, framesOnDisk ? &frameStore : NULL);
+	QStringList failed;
+	bool ok = true;
+	if (!files.isEmpty())
+		ok = waitForImages(QtConcurrent::mapped(files, loader), pendingFiles, fileSizes, failed);
+	if (ok && !frames.isEmpty())
+		ok = waitForImages(QtConcurrent::mapped(frames, loader), pendingFrames, frameSizes, failed);
+	
+	for ( int i=0 ; i<frameItems.size() ; i++ )
+		if (!pendingFrames[i]->isNull()) frameItems[i]->setData(SvgDataRole, QVariant());
+	
+	if (!failed.isEmpty()) {
+		QMessageBox::warning(
+			this,
+			tr("Warning"),
+			tr("Could not load the images ") + failed.join(", ") +
+				tr(". They might have been changed or removed since they were opened."));
+		return false;
+	}
+	
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+/* Show a modal progress dialog until the images of future are decoded
+ * and assign them to pending, which are expected to be of sizes. The
+ * names of the images that could not be decoded are added to failed.
+ * Returns false if decoding has been canceled.
+ */
+bool MainWindow::waitForImages(
+	QFuture< LoadedImage > future,
+	const std::vector< QImage* >& pending,
+	const QList< QSize >& sizes,
+	QStringList& failed)
+{
+	QProgressDialog progress(tr("Loading images ..."), tr("Cancel"), 0, pending.size(), this);
+	progress.setWindowModality(Qt::WindowModal);
+	
+	/* the dialog's event loop ends as soon as the dialog is reset */
+	QFutureWatcher< LoadedImage > watcher;
+	connect(&watcher, SIGNAL(progressValueChanged(int)), &progress, SLOT(setValue(int)));
+	connect(&watcher, SIGNAL(finished()), &progress, SLOT(reset()));
+	connect(&progress, SIGNAL(canceled()), &watcher, SLOT(cancel()));
+	watcher.setFuture(future);
+	progress.exec();
+	watcher.waitForFinished();
+	
+	for ( unsigned int i=0 ; i<pending.size() ; i++ ) {
+		if (!future.isResultReadyAt(i)) continue;
+		
+		LoadedImage loaded = future.resultAt(i);
+		if (loaded.image && loaded.image->size() == sizes[i]) {
+			/* the list item keeps its pointer, the pixels are shared */
+			*pending[i] = *loaded.image;
+			delete loaded.image;
+		} else {
+			failed << loaded.fileName;
+			deleteImage(loaded.image);
+		}
+	}
+	
+	return !future.isCanceled();
+}
+
+//----------------------------------------------------------------------
+
 QString MainWindow::getSupportedImageFormats() const
 {
 	QString imageFilter(tr("Images ("));
@@ -385,6 +667,12 @@ QString MainWindow::getSupportedImageFormats() const
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+	/* do not leave a computation running in the background */
+	if (composer) {
+		composer->cancel();
+		computeWatcher.waitForFinished();
+	}
+	
 	saveSettings();
 	event->accept();
 }
@@ -394,6 +682,14 @@ void MainWindow::closeEvent(QCloseEvent *event)
 void MainWindow::keyReleaseEvent(QKeyEvent *event)
 {
 	if (event->matches(QKeySequence::Delete)) {
+		/* the images being computed are kept to save the animation
+		 * later, see computeFinished(). They must stay until then.
+		 */
+		if (composer) {
+			statusBar()->showMessage(tr("Images cannot be removed while the animation is computed."), 5000);
+			return;
+		}
+
 		/* if the delete key has been released, delete all selected 
 		 * items. start in the back to not mess up with the indices.
 		 */
@@ -401,7 +697,7 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
 			QListWidgetItem *li = imageList->item(i);
 			if (li->isSelected()) {
 				imageList->takeItem(i);
-				delete getImage(li);
+				deleteImage(getImage(li));
 				delete li;
 			}
 		}
@@ -413,6 +709,9 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
 
 void MainWindow::openFile()
 {
+	/* only one batch of images is loaded at a time */
+	if (openProgress) return;
+	
 	/* get list of files to load */
 	
 	QStringList files = QFileDialog::getOpenFileNames(
@@ -422,78 +721,195 @@ void MainWindow::openFile()
 		getSupportedImageFormats());
 	
 	if (files.size() > 0) openDir.setPath(files[0]);
+	else return;
 	if (setSaveToOpen) {
         saveDirImage = QFileInfo(openDir.absolutePath()).absolutePath();
         saveDirAnimation = QFileInfo(openDir.absolutePath()).absolutePath();
 		setSaveToOpen = false;
 	}
 	
-	QSize iconSize = imageList->iconSize();
+	beginOpen(files.size());
+	
+	/* decode the images and create their thumbnails on the thread pool.
+	 * The list items are added in openImageReady(), as soon as an image
+	 * and all images selected before it are done.
+	 */
+	
+	openWatcher.setFuture(QtConcurrent::mapped(files, ImageLoader(imageList->iconSize().height(), framesOnDisk ? &frameStore : NULL, &thumbnailCache)));
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Load the frames of an animation saved by saveAnimation()
+ *
+ * Reading the SVG file does not decode any frame, see SvgReader. The list
+ * items keep the encoded frames, which are only decoded for their
+ * thumbnails, in the background as openFile() does, and once more when
+ * the animation is computed, see decodeImages(). Only then the encoded
+ * frames are dropped. The strip width and
+ * duration of the animation become the defaults for the next computation
+ * and for saving.
+ */
+void MainWindow::openAnimation()
+{
+	/* only one batch of images is loaded at a time */
+	if (openProgress) return;
+	
+	QString filename = QFileDialog::getOpenFileName(
+		this,
+		tr("Open SVG animation to edit"),
+		saveDirAnimation.absolutePath(),
+		tr("SVG animation file (*.svg)"));
+	
+	if (filename.isNull()) return;
+	
+	QFile xmlFile(filename);
+	if (!xmlFile.open(QIODevice::ReadOnly)) {
+		QMessageBox::warning(
+			this,
+			tr("Warning"),
+			tr("Failed to open ") + xmlFile.fileName() + tr(" for reading."));
+		return;
+	}
+	
+	SvgReader reader;
+	SvgReader::Error error = reader.read(&xmlFile, QFileInfo(filename).fileName());
+	xmlFile.close();
 	
-	/* prepare progressbar */
+	if (error != SvgReader::NoError) {
+		QMessageBox::warning(
+			this,
+			tr("Warning"),
+			QCoreApplication::translate("SvgReader", SvgReader::errorString(error)));
+		return;
+	}
 	
-	QProgressBar *pbar = new QProgressBar(statusBar());
-	pbar->setMinimum(0);
-	pbar->setMaximum(files.size());
-	pbar->setOrientation(Qt::Horizontal);
-	pbar->setFormat(tr("Loading image %v of %m"));
-	statusBar()->addWidget(pbar, 1);
+	openDir.setPath(filename);
+	saveDirAnimation.setPath(filename);
+	if (reader.stripWidth() > 0) stripWidth = reader.stripWidth();
+	if (reader.duration() > 0.) animDuration = reader.duration();
 	
-	/* open the images */
+	beginOpen(reader.frames().size());
+	openFrames = reader.frames();
+	openWatcher.setFuture(QtConcurrent::mapped(openFrames, ImageLoader(imageList->iconSize().height(), framesOnDisk ? &frameStore : NULL, &thumbnailCache)));
+}
+
+//----------------------------------------------------------------------
+
+/* Show the progress bar for loading nrImages images and reset what
+ * openImageReady() and openFinished() collect.
+ */
+void MainWindow::beginOpen(int nrImages)
+{
+	openProgress = new QProgressBar(statusBar());
+	openProgress->setMinimum(0);
+	openProgress->setMaximum(nrImages);
+	openProgress->setOrientation(Qt::Horizontal);
+	openProgress->setFormat(tr("Loading image %v of %m"));
+	statusBar()->addWidget(openProgress, 1);
+	
+	openNext = 0;
+	openFrames.clear();
+	openWarnings.clear();
+	openDecodeTime = 0;
+	openNormalizeTime = 0;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Add the decoded images to the image list
+ *
+ * Called whenever the background decoding started in openFile() has a new
+ * result. Results may arrive in any order, but we add the list items in the
+ * order the files were selected in. So we add all consecutive results
+ * starting at openNext.
+ */
+void MainWindow::openImageReady()
+{
+	TraceSpan span("openImageReady");
 	
-	for ( int i=0 ; i < files.size() ; i++ ) {
-		pbar->setValue(i+1);
-		
-		/* open the image, we will keep this pointer until the image
-		 * is removed from the list or program quits.
-		 */
-		QImage *img = new QImage(files[i]);
+	QFuture< LoadedImage > future = openWatcher.future();
+	
+	while (openNext < future.resultCount() && future.isResultReadyAt(openNext)) {
+		int idx = openNext++;
+		LoadedImage loaded = future.resultAt(idx);
+		openProgress->setValue(openNext);
+		openDecodeTime += loaded.decodeTime;
+		openNormalizeTime += loaded.normalizeTime;
 		
 		/* check if open was succesful */
-		if (!img || img->isNull()) {
-			QMessageBox::warning(
-				this, 
-				tr("Warning"), 
-				tr("Could not load image ") + files[i] + 
-				tr(". Please verify that it is an image file of proper format."));
-			if (img) delete img;
+		if (!loaded.image) {
+			openWarnings << tr("Could not load image ") + loaded.fileName + 
+				tr(". Please verify that it is an image file of proper format.");
 			continue;
 		}
 		
-		/* check if image is of correct size */
-		if ((imageList->count()) > 0 && (getImage(0)->size() != img->size())) {
-			QMessageBox::warning(
-				this,
-				tr("Warning"),
-				tr("All input images must be of same size. However, image ") + 
-				files[i] + tr(" is not of reference pixel size ") +
-				QString("%1").arg(getImage(0)->size().width()) + "x" + 
-				QString("%1").arg(getImage(0)->size().height()) + 
-				tr(". Hence, it will not be loaded."));
-			delete img;
+		/* we will keep this pointer until the image is removed from the
+		 * list or program quits.
+		 */
+		QImage *img = loaded.image;
+		
+		/* check if image is of correct size. The image itself may not have
+		 * been decoded yet, see ImageLoader.
+		 */
+		if ((imageList->count()) > 0 && (getImageSize(0) != loaded.size)) {
+			openWarnings << tr("All input images must be of same size. However, image ") + 
+				loaded.fileName + tr(" is not of reference pixel size ") +
+				QString("%1").arg(getImageSize(0).width()) + "x" + 
+				QString("%1").arg(getImageSize(0).height()) + 
+				tr(". Hence, it will not be loaded.");
+			deleteImage(img);
 			continue;
 		}
 		
-		/* create thumbnail. Do not use Qt::FastTransformation, it 
-		 * displays resulting baseImages after scaling worong (e.g.
-		 * only one of the input images.
-		 */
-		QImage thumbnail = img->scaledToHeight(iconSize.height(), Qt::SmoothTransformation);
-		QIcon icon(QPixmap::fromImage(thumbnail));
+		QIcon icon(QPixmap::fromImage(loaded.thumbnail));
 		
-		if (iconSize.width() <= 0) imageList->setIconSize(thumbnail.size());
+		if (imageList->iconSize().width() <= 0) imageList->setIconSize(loaded.thumbnail.size());
 		
 		/* create new list entry and add it */
-		QFileInfo fi(files[i]);
+		QFileInfo fi(loaded.fileName);
 		QListWidgetItem *li = new QListWidgetItem(icon, fi.fileName(), imageList);
 		li->setData(Qt::UserRole, qVariantFromValue(img));
+		li->setData(SizeRole, loaded.size);
+		li->setData(FileNameRole, loaded.fileName);
+		if (idx < openFrames.size()) li->setData(SvgDataRole, openFrames[idx].data);
 		li->setFlags(li->flags() | Qt::ItemIsDragEnabled);
 		imageList->addItem(li);	
 	}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Finish loading the images started in openFile()
+ *
+ * All problems found while loading are reported at once, so a batch of
+ * images does not bring up one message box per image.
+ */
+void MainWindow::openFinished()
+{
+	openImageReady();
 	
 	/* remove progress bar again */
-	statusBar()->removeWidget(pbar);
-	delete pbar;
+	statusBar()->removeWidget(openProgress);
+	delete openProgress;
+	openProgress = NULL;
+	openFrames.clear();
+	
+	/* the loaders have added their thumbnails, none is running anymore */
+	thumbnailCache.prune();
+	
+	/* the times are summed up over all threads */
+	statusBar()->showMessage(
+		tr("Images decoded in %1 ms, converted in %2 ms.").arg(openDecodeTime).arg(openNormalizeTime),
+		5000);
+	
+	if (!openWarnings.isEmpty()) {
+		QMessageBox::warning(
+			this, 
+			tr("Warning"), 
+			openWarnings.join("\n"));
+		openWarnings.clear();
+	}
 }
 
 //----------------------------------------------------------------------
@@ -524,9 +940,9 @@ void MainWindow::compute()
 
 bool MainWindow::compute(const std::vector< QImage* > imgs)
 {
-    /* store this to save the animation later */
-    m_animationImages = imgs;
-
+	/* only one computation at a time */
+	if (composer) return false;
+	
 	int nrImgs = imgs.size();
 	
 	if (nrImgs <= 0) {
@@ -537,8 +953,17 @@ bool MainWindow::compute(const std::vector< QImage* > imgs)
 		return false;
 	}
 	
+	if (!decodeImages(imgs)) return false;
+	
 	QSize size0 = imgs[0]->size();
 	
+	/* the frames are identified by their cache keys, in resultCache and
+	 * when looking for the strips that changed. Take them now, the images
+	 * may be deleted while we compute in the background.
+	 */
+	std::vector< qint64 > keys(nrImgs);
+	for ( int i=0 ; i<nrImgs ; i++ ) keys[i] = imgs[i]->cacheKey();
+	
 	/* get strip width in pixels */
 	
 	bool ok;
@@ -554,130 +979,330 @@ bool MainWindow::compute(const std::vector< QImage* > imgs)
 	
 	if (!ok) return false;		
 	
-	/* reset results */
-	baseImage = QImage();
-	barMask = QImage();
+	/* the same frames in the same order have been computed before */
+	QImage cachedBase, cachedMask;
+	if (resultCache.find(keys, stripWidth, cachedBase, cachedMask)) {
+		baseImage = cachedBase;
+		barMask = cachedMask;
+		m_animationImages = imgs;
+		m_animationKeys = keys;
+		statusBar()->showMessage(tr("Animation taken from the result cache."), 5000);
+		showAnimation();
+		return true;
+	}
+	
+	/* compute baseImage and barMask in the background, both in bands of
+	 * rows on all the threads we are allowed to use. The current results
+	 * are kept until the computation has finished successfully, see
+	 * computeFinished().
+	 */
 	
-	/* setup progress bar */
+	composer = new Composer(this);
+	composer->setStripWidth(stripWidth);
+	composer->setThreadCount(threadCount);
+	if (!composer->setFrames(imgs)) {
+		delete composer;
+		composer = NULL;
+		QMessageBox::warning(
+			this,
+			tr("Warning"),
+			tr("Failed to compute the animation. All input images must be of same size."));
+		return false;
+	}
 	
-	QProgressBar *pbar = new QProgressBar(statusBar());
-	pbar->setMinimum(0);
-	pbar->setMaximum(2*size0.width());
-	pbar->setOrientation(Qt::Horizontal);
-	pbar->setFormat(tr("Processing %p%"));
-	statusBar()->addWidget(pbar, 1);
+	/* store this to save the animation later, once it has been computed */
+	m_computeImages = imgs;
+	m_computeKeys = keys;
 	
-	/*
-	 * at first, compute baseImage
+	/* if only some of the frames have been reordered or replaced since
+	 * the current animation, only the strips of the frames at changed
+	 * positions are rewritten, see Composer::update(). The composer does
+	 * so on its own copy of baseImage, so the current animation stays
+	 * until the new one is done, or if it fails or is canceled. If all
+	 * positions changed, we compute from scratch.
 	 */
+	std::vector< bool > changed;
+	unsigned int nrFrames, oldStripWidth;
+	if (!baseImage.isNull() &&
+		baseImage.size() == size0 &&
+		m_animationKeys.size() == keys.size() &&
+		BarMask::decode(barMask, nrFrames, oldStripWidth) == BarMask::NoError &&
+		nrFrames == keys.size() &&
+		(int) oldStripWidth == stripWidth) {
+		changed.resize(keys.size());
+		for ( unsigned int i=0 ; i<keys.size() ; i++ ) changed[i] = (keys[i] != m_animationKeys[i]);
+	}
+	if (std::find(changed.begin(), changed.end(), false) != changed.end())
+		composer->setPrevious(baseImage, barMask, changed);
 	
-	baseImage = QImage(size0, QImage::Format_ARGB32_Premultiplied);
+	/* setup progress bar and cancel button */
 	
-	/* go from left to right through baseImage. Write k columns of each
-	 * image again and again.
-	 */
-	for ( int col=0 ; col<size0.width() ; )
-		for ( int i=0 ; i<nrImgs ; i++ )
-			for ( int j=0 ; j<stripWidth && col<size0.width() ; j++, col++ ) {
-				pbar->setValue(col+1);
-				for ( int row=0 ; row<size0.height() ; row++ )
-					baseImage.setPixel(col, row, imgs[i]->pixel(col, row));
-			}
+	computeProgress = new QProgressBar(statusBar());
+	computeProgress->setMinimum(0);
+	computeProgress->setMaximum(100);
+	computeProgress->setOrientation(Qt::Horizontal);
+	computeProgress->setFormat(tr("Processing %p%"));
+	statusBar()->addWidget(computeProgress, 1);
 	
-	/*
-	 * then, compute barmask
-	 */
+	connect(composer, SIGNAL(progressChanged(int)), computeProgress, SLOT(setValue(int)));
 	
-	barMask = QImage(size0, QImage::Format_Mono);
-	for ( int col=0 ; col < size0.width() ; )
-		for ( int i=0 ; i<nrImgs ; i++ )
-			for ( int j=0 ; j<stripWidth && col<size0.width() ; j++, col++ ) {
-				pbar->setValue(size0.width()+col+1);
-				for ( int row=0 ; row < size0.height() ; row++ )
-					barMask.setPixel(col, row, (i == 0) ? 1 : 0 );
-			}
-			
-	/* image is the one displayed on imageLabel */
+	computeCancel = new QPushButton(tr("Cancel"), statusBar());
+	statusBar()->addWidget(computeCancel);
 	
-	image = QImage(size0, QImage::Format_ARGB32_Premultiplied);
+	connect(computeCancel, SIGNAL(clicked()), composer, SLOT(cancel()));
 	
-	/* remove progress bar again */
-	statusBar()->removeWidget(pbar);
-	delete pbar;
+	computeTimer.start();
+	computeWatcher.setFuture(QtConcurrent::run(composer, &Composer::run));
+	
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Take over the results of a background computation
+ *
+ * Called when the computation started in compute() has finished, either
+ * successfully, with an error or because it has been canceled. Only in the
+ * first case, baseImage and barMask are replaced.
+ */
+void MainWindow::computeFinished()
+{
+	TraceSpan span("computeFinished");
+	
+	/* remove progress bar and cancel button again */
+	statusBar()->removeWidget(computeProgress);
+	computeProgress->deleteLater();
+	computeProgress = NULL;
+	statusBar()->removeWidget(computeCancel);
+	computeCancel->deleteLater();
+	computeCancel = NULL;
+	
+	bool ok = computeWatcher.result();
+	bool canceled = composer->isCanceled();
+	qint64 computeTime = computeTimer.elapsed();
+	int nrConverted = composer->nrConverted();
+	int nrRewritten = composer->nrRewritten();
+	int nrFrames = m_computeKeys.size();
+	if (ok) {
+		baseImage = composer->baseImage();
+		barMask = composer->barMask();
+		m_animationImages = m_computeImages;
+		m_animationKeys = m_computeKeys;
+		resultCache.insert(m_computeKeys, stripWidth, baseImage, barMask);
+	}
+	
+	composer->deleteLater();
+	composer = NULL;
+	m_computeImages.clear();
+	m_computeKeys.clear();
+	
+	/* frames removed while computing may be unmapped now */
+	frameStore.purge();
+	
+	if (!ok) {
+		if (canceled) statusBar()->showMessage(tr("Computation canceled."), 5000);
+		else QMessageBox::warning(
+			this,
+			tr("Warning"),
+			tr("Failed to compute the animation. The images might be too large to fit into memory."));
+		return;
+	}
+	
+	if (nrRewritten < nrFrames)
+		statusBar()->showMessage(
+			tr("Animation updated in %1 ms, the strips of %2 of %3 images have been rewritten.").arg(computeTime).arg(nrRewritten).arg(nrFrames),
+			5000);
+	else
+		statusBar()->showMessage(
+			tr("Animation computed in %1 ms, %2 images had to be converted.").arg(computeTime).arg(nrConverted),
+			5000);
+	
+	showAnimation();
+}
+
+//----------------------------------------------------------------------
+
+/* Display baseImage and the previews of a new animation of
+ * m_animationImages, computed or taken from the result cache.
+ */
+void MainWindow::showAnimation()
+{
+	/* setup the previews displayed on imageView */
+	
+	preview.setBase(baseImage, stripWidth, m_animationImages.size());
+	previewImages.clear();
+	previewImages.resize(m_animationImages.size() + 1);
+	imageView->clearCache();
+	
+	if (scrollArea->widget() != imageView) {
+		scrollArea->takeWidget();
+		imageLabel->hide();
+		scrollArea->setWidget(imageView);
+		imageView->show();
+	}
 	
 	/* reset zoomFactor to one before the slider signal is triggered */
 	zoomFactor = 1.;
 	
 	/* configure slider to current setup */
-	slider->setRange(0, nrImgs);
+	slider->setRange(0, m_animationImages.size());
 	slider->setSingleStep(1);
 	slider->setTracking(true);
 	slider->setValue(0);
 	slider->setTickPosition(QSlider::TicksBelow);	
-	connect(slider, SIGNAL(valueChanged(int)), this, SLOT(sliderChangedValue(int)));
+	connect(slider, SIGNAL(valueChanged(int)), this, SLOT(sliderChangedValue(int)), Qt::UniqueConnection);
 	/* when slider's default value is zero, setValue will not trigger 
 	 * the signal. hence we setValue before connect and then call the
 	 * signal handler for 0.
 	 */
 	sliderChangedValue(0);
+	
+	/* render the other previews while we are idle */
+	QTimer::singleShot(0, this, SLOT(precomputePreview()));
+}
 
-	return true;
+//----------------------------------------------------------------------
+
+/*! \brief Ask for the number of threads to compute the animation on
+ *
+ * Zero, the default, uses one thread per processor core.
+ */
+void MainWindow::setThreadCount()
+{
+	bool ok;
+	int count = QInputDialog::getInt(
+		this,
+		tr("Enter number of threads"),
+		tr("Number of threads (0 for one per processor core):"),
+		threadCount,
+		0,
+		256,
+		1,
+		&ok);
+	
+	if (ok) threadCount = count;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Ask for the memory kept for recently computed animations
+ *
+ * Zero disables the result cache.
+ */
+void MainWindow::setResultCacheSize()
+{
+	bool ok;
+	int size = QInputDialog::getInt(
+		this,
+		tr("Enter result cache size"),
+		tr("Memory for recently computed animations in MB (0 to disable):"),
+		resultCacheSize,
+		0,
+		65536,
+		64,
+		&ok);
+	
+	if (!ok) return;
+	
+	resultCacheSize = size;
+	resultCache.setMaxBytes((qint64) resultCacheSize * 1024 * 1024);
+}
+
+//----------------------------------------------------------------------
+
+void MainWindow::setCompactSvg(bool compact)
+{
+	compactSvg = compact;
+}
+
+//----------------------------------------------------------------------
+
+void MainWindow::setPngCompression(QAction *action)
+{
+	pngCompression = (PngWriter::Compression) action->data().toInt();
+}
+
+//----------------------------------------------------------------------
+
+void MainWindow::setFramesOnDisk(bool onDisk)
+{
+	framesOnDisk = onDisk;
+}
+
+//----------------------------------------------------------------------
+
+SvgWriter::Style MainWindow::svgStyle() const
+{
+	return compactSvg ? SvgWriter::Compact : SvgWriter::Formatted;
 }
 
 //----------------------------------------------------------------------
 
 void MainWindow::sliderChangedValue(int idx)
 {
-	if (idx == 0) {
-		/* for idx=0, display without mask. */
-		currentPixmap = QPixmap::fromImage(baseImage);
-	} else {
-		/* this will see some optimization one day. for now, it's a 
-		 * proof of concept 
-		 */
-		
-		QPainter painter(&image);
-		
-		/* when we move the mask to the right, there is a hole that 
-		 * needs to be filled with black color to the left.
-		 */
-		if (idx > 1) {
-			painter.setPen(QColor(0,0,0));
-			painter.fillRect(0,0,stripWidth*(idx-1),image.size().height(),Qt::SolidPattern);
-		}
-		
-		/* set barMask with some offset to the right */
-		painter.setCompositionMode(QPainter::CompositionMode_Source);
-		painter.drawImage(stripWidth*(idx-1), 0, barMask);
-		
-		/* finally, multiply baseImage */
-		painter.setCompositionMode(QPainter::CompositionMode_Multiply);
-		painter.drawImage(0, 0, baseImage);
+	if (idx < 0 || idx > preview.nrFrames()) return;
+	
+	TraceSpan span("sliderChangedValue");
+	
+	/* for idx=0, display without mask. */
+	QImage current;
+	if (idx == 0) current = baseImage;
+	else if (!previewImages[idx].isNull()) current = previewImages[idx];
+	else {
+		current = preview.render(idx);
+		if (previewCacheAll()) previewImages[idx] = current;
+	}
+	
+	/* the view only scales and converts the tiles it displays */
+	imageView->setImage(current, idx);
+	renderCurrentView();
+}
 
-		painter.end();
+//----------------------------------------------------------------------
+
+/*! \brief Check if all previews fit into the preview cache
+ *
+ * With all previews cached, moving the slider only swaps images. For very
+ * large images, we only keep the one currently displayed.
+ */
+bool MainWindow::previewCacheAll() const
+{
+	const qint64 budget = (qint64) 512 * 1024 * 1024;
+	
+	/* monochrome and indexed base images mostly have indexed previews,
+	 * see PreviewCompositor::setBase()
+	 */
+	int bytesPerPixel = (preview.format() == QImage::Format_Indexed8) ? 1 : 4;
+	
+	return (qint64) (previewImages.size() - 1) * baseImage.width() * baseImage.height() * bytesPerPixel <= budget;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Render the next missing preview into the cache
+ *
+ * One preview is rendered per call, then we return to the event loop and
+ * get called again, so the user interface stays responsive meanwhile.
+ */
+void MainWindow::precomputePreview()
+{
+	if (!previewCacheAll()) return;
+	
+	for ( int idx=1 ; idx<previewImages.size() ; idx++ ) {
+		if (!previewImages[idx].isNull()) continue;
+		
+		previewImages[idx] = preview.render(idx);
 		
-		/* currentPixmap is 1:1 version from which any zoom is computed */
-		currentPixmap = QPixmap::fromImage(image);
+		QTimer::singleShot(0, this, SLOT(precomputePreview()));
+		return;
 	}
-	
-	renderCurrentPixmap();
 }
 
 //----------------------------------------------------------------------
 
-void MainWindow::renderCurrentPixmap()
+void MainWindow::renderCurrentView()
 {
-	if (zoomFactor != 1.)
-		/* no smoothing, as we want to see the pixels */
-		imageLabel->setPixmap(
-			currentPixmap.scaled(
-				zoomFactor*currentPixmap.width(), 
-				zoomFactor*currentPixmap.height(), 
-				Qt::IgnoreAspectRatio, 
-				Qt::FastTransformation)
-		);	
-	else imageLabel->setPixmap(currentPixmap);
-	imageLabel->resize(imageLabel->pixmap()->size());
+	imageView->setZoom(zoomFactor);
 }
 
 //----------------------------------------------------------------------
@@ -710,7 +1335,7 @@ bool MainWindow::saveImage(const QImage& img, const QString& caption)
 			
 		if (!filename.isNull()) {
             saveDirImage.setPath(filename);
-			if (!img.save(filename))
+			if (!PngWriter::save(img, filename, pngCompression))
 				QMessageBox::warning(
 					this, 
 					tr("Warning"), 
@@ -751,7 +1376,7 @@ bool MainWindow::animationIsComputed()
  * This method takes an already computed animation and saves it to an animated
  * SVG file. This is done in such a way, that the animation may be rendered
  * by viewing the SVG file in any modern browser. Moreover, the animation
- * shall be loadable to animbar for further edit in future versions.
+ * may be loaded to animbar for further edit, see openAnimation().
  *
  * See:
  *  http://www.w3.org/TR/SVG/animate.html#CalcModeAttribute
@@ -796,48 +1421,19 @@ void MainWindow::saveAnimation()
     }
 
     bool ok;
-    double animDuration = QInputDialog::getDouble(this, "Animation Duration", "Duration of Animation (s): ", nrFrames, 0, 100000, 2, &ok);
+    double duration = QInputDialog::getDouble(this, "Animation Duration", "Duration of Animation (s): ", (animDuration > 0.) ? animDuration : nrFrames, 0, 100000, 2, &ok);
     if (!ok) return;
+    animDuration = duration;
 
     /*
      * write XML
      */
 
-    QXmlStreamWriter xmlOutput(&xmlFile);
-    xmlOutput.setAutoFormatting(true);
-
-    xmlOutput.writeStartDocument("1.0", false);
-    xmlOutput.writeDTD("<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\" \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">");
-
-    xmlOutput.writeStartElement("svg");
-    xmlOutput.writeAttribute("xmlns", "http://www.w3.org/2000/svg");
-    xmlOutput.writeAttribute("xmlns:xlink", "http://www.w3.org/1999/xlink");
-    xmlOutput.writeAttribute("version", "1.1");
-    xmlOutput.writeAttribute("width", QString::number(barMask.width()));
-    xmlOutput.writeAttribute("height", QString::number(barMask.height()));
-
-    /* write complete images before the bar mask */
-
-    for ( unsigned int i=0 ; i<nrFrames ; i++ ) {
-        xmlWriteImage(xmlOutput, *m_animationImages[i], i*(m_animationImages[i]->width() - stripWidth));
-        xmlWriteAnimation(xmlOutput, m_animationImages[i]->width(), nrFrames, animDuration);
-        xmlOutput.writeEndElement();
-        xmlOutput.writeEndElement();
-    }
-
-    /* We write a copy of barMask, that has the white color replaced by a
-     * fully transparent color.
-     */
-    QImage barMaskCopy = barMask;
-    QVector< QRgb > colorTable = barMaskCopy.colorTable();
-    colorTable[1] = QColor(255,255,255,0).rgba();
-    barMaskCopy.setColorTable(colorTable);
-    xmlWriteImage(xmlOutput, barMaskCopy, 0);
-    xmlOutput.writeEndElement();
-
-    /* epilog */
-    xmlOutput.writeEndElement();        // svg
-    xmlOutput.writeEndDocument();
+    if (!SvgWriter::saveAnimation(&xmlFile, m_animationImages, barMask, stripWidth, animDuration, svgStyle(), pngCompression))
+        QMessageBox::warning(
+            this,
+            tr("Warning"),
+            tr("Failed to write ") + xmlFile.fileName()  + tr("."));
 
     xmlFile.close();
 }
@@ -881,8 +1477,9 @@ void MainWindow::exportAnimation()
     saveDirAnimation.setPath(filename);
 
     bool ok;
-    double animDuration = QInputDialog::getDouble(this, "Animation Duration", "Duration of Animation (s): ", nrFrames, 0, 100000, 2, &ok);
+    double duration = QInputDialog::getDouble(this, "Animation Duration", "Duration of Animation (s): ", (animDuration > 0.) ? animDuration : nrFrames, 0, 100000, 2, &ok);
     if (!ok) return;
+    animDuration = duration;
 
     QFile xmlFile(filename);
     if (!xmlFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -893,213 +1490,41 @@ void MainWindow::exportAnimation()
         return;
     }
 
-    QXmlStreamWriter xmlOutput(&xmlFile);
-    xmlOutput.setAutoFormatting(true);
-
-    xmlOutput.writeStartDocument("1.0", false);
-    xmlOutput.writeDTD("<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\" \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">");
-
-    xmlOutput.writeStartElement("svg");
-    xmlOutput.writeAttribute("xmlns", "http://www.w3.org/2000/svg");
-    xmlOutput.writeAttribute("xmlns:xlink", "http://www.w3.org/1999/xlink");
-    xmlOutput.writeAttribute("version", "1.1");
-    xmlOutput.writeAttribute("width", QString::number(barMask.width()));
-    xmlOutput.writeAttribute("height", QString::number(barMask.height()));
-
-    /* write complete images before the bar mask */
-
-    xmlWriteImage(xmlOutput, baseImage, 0);
-    xmlWriteAnimation(xmlOutput, stripWidth, nrFrames, animDuration);
-    xmlOutput.writeEndElement();
-    xmlOutput.writeEndElement();
+    if (!SvgWriter::exportAnimation(&xmlFile, baseImage, barMask, stripWidth, nrFrames, animDuration, svgStyle(), pngCompression))
+        QMessageBox::warning(
+            this,
+            tr("Warning"),
+            tr("Failed to write ") + xmlFile.fileName()  + tr("."));
 
-    /* We write a copy of barMask, that has the white color replaced by a
-     * fully transparent color.
-     */
-    QImage barMaskCopy = barMask;
-    QVector< QRgb > colorTable = barMaskCopy.colorTable();
-    colorTable[1] = QColor(255,255,255,0).rgba();
-    barMaskCopy.setColorTable(colorTable);
-    xmlWriteImage(xmlOutput, barMaskCopy, 0);
-    xmlOutput.writeEndElement();
-
-    /* epilog */
-    xmlOutput.writeEndElement();        // svg
-    xmlOutput.writeEndDocument();
     xmlFile.close();
 }
 
 //----------------------------------------------------------------------
 
-/*! \brief Write image in base64 encoded PNG format
- *
- * SVG files support embedding of images as base64 encoded PNG files. This
- * method writes an entire SVG image tag with the image file as xlink.
- * We do not end the element, so the caller must call
- *      xmlOutput.writeEndElement();
- * sooner or later.
- *
- * \param xmlOutput
- * \param image
- * \param x0
- *
- * \return
- */
-bool MainWindow::xmlWriteImage(
-        QXmlStreamWriter& xmlOutput,
-        const QImage& image,
-        unsigned int x0) const
-{
-    xmlOutput.writeStartElement("image");
-    xmlOutput.writeAttribute("id", "barMask");
-    xmlOutput.writeAttribute("width", QString::number(image.width()));
-    xmlOutput.writeAttribute("height", QString::number(image.height()));
-    xmlOutput.writeAttribute("x", QString::number(x0));
-    xmlOutput.writeAttribute("y", QString::number(0));
-
-    /* This is copied from the QT docs */
-    QByteArray byteArray;
-    QBuffer buffer(&byteArray);
-    buffer.open(QIODevice::ReadWrite);
-    image.save(&buffer, "PNG");
-    xmlOutput.writeAttribute("xlink:href", QString("data:image/png;base64,") + QString(buffer.buffer().toBase64().data()));
-    buffer.close();
-
-    return true;
-}
-
-//----------------------------------------------------------------------
-
-/*! \brief Write animation element.
- *
- * We do not end the element, so the caller must call
- *      xmlOutput.writeEndElement();
- * sooner or later.
- *
- * \param xmlOutput
- * \param image
- * \param nrFrames
- *
- * \return
- */
-bool MainWindow::xmlWriteAnimation(
-        QXmlStreamWriter& xmlOutput,
-        int delta,
-        unsigned int nrFrames,
-        double duration) const
-{
-    xmlOutput.writeStartElement("animateMotion");
-    xmlOutput.writeAttribute("dur", QString("%1s").arg(duration));
-    xmlOutput.writeAttribute("calcMode", "discrete");
-    xmlOutput.writeAttribute("repeatCount", "indefinite");
-    QString values, keyTimes;
-    for (unsigned int i=0; i<nrFrames; i++) {
-        values += QString("%1,0;").arg((-1) * ((int) i) * delta);
-        keyTimes += QString("%1;").arg(((float) i) / (nrFrames));
-    }
-    xmlOutput.writeAttribute("values", values);
-    xmlOutput.writeAttribute("keyTimes", keyTimes);
-
-    return true;
-}
-
-//----------------------------------------------------------------------
-
 /*! \brief Get parameters from bar mask image
  *
- * This method reconstruct number of frames and pixel width per frame from
- * a bar mask image. Please note that this works with pixel indices on a
- * monochrome image only. The 0 index is considered to be the opaque bars
- * (usually black), while the 1 indices are the transparent bars (usually
- * transparent or white).
+ * See BarMask::decode(), in addition we tell the user what is wrong with
+ * the bar mask.
  *
  * \param img Bar mask image
  * \param nrFrames (out) Number of frame images
  * \param stripWidth (out) Strip width in pixels
  *
  * \return True if reconstruction of parameters was successful and false
- *  otherwise. The latter case indicates that the provided image is not a valid
- *  bar mask image.
+ *  otherwise.
  */
 bool MainWindow::getParameters(const QImage& img, unsigned int& nrFrames, unsigned int& stripWidth)
 {
-    nrFrames = 0;
-    stripWidth = 0;
-
-    /* check format */
-    if (img.format() != QImage::Format_Mono) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of invalid format."));
-        return false;
-    }
+    BarMask::DecodeError error = BarMask::decode(img, nrFrames, stripWidth);
 
-    /* we start with a white strip, followed by the black strips */
-    if (img.pixelIndex(0,0) != 1) {
+    if (error != BarMask::NoError) {
         QMessageBox::warning(
             this,
             tr("Warning"),
-            tr("The bar mask image is of unexpected contents."));
+            QCoreApplication::translate("BarMask", BarMask::errorString(error)));
         return false;
     }
 
-    /* We examine the first row always. The width of the white strip is the
-     * stripwidth
-     */
-    while ((img.pixelIndex(stripWidth,0) == 1) && (stripWidth < (unsigned int) img.width())) stripWidth++;
-
-    if (stripWidth >= (unsigned int) img.width()) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of unexpected size (stripWidth)."));
-        return false;
-    }
-
-    if (stripWidth == 0) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of unsupported contents (stripWidth)."));
-        return false;
-    }
-
-    /* The number of frame images is the width of the black strip, divided by
-     * the strip width, plus one.
-     */
-    nrFrames = stripWidth;
-    while ((img.pixelIndex(nrFrames,0) == 0) && (nrFrames < (unsigned int) img.width())) nrFrames++;
-
-    if (nrFrames >= (unsigned int) img.width()) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of unexpected size (nrFrames)."));
-        return false;
-    }
-
-    /* check */
-
-    if (nrFrames == 0) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of unsupported contents (nrFrames)."));
-        return false;
-    }
-
-    div_t res = div((int) nrFrames, (int) stripWidth);
-    if (res.rem != 0) {
-        QMessageBox::warning(
-            this,
-            tr("Warning"),
-            tr("The bar mask image is of invalid contents (nrFrames)."));
-        return false;
-    }
-
-    nrFrames /= stripWidth;
-
     return true;
 }
 
@@ -1109,7 +1534,7 @@ void MainWindow::zoomIn()
 {
 	zoomFactor *= 1.25;
 	
-	renderCurrentPixmap();
+	renderCurrentView();
 }
 
 //----------------------------------------------------------------------
@@ -1118,7 +1543,7 @@ void MainWindow::zoomOut()
 {
 	zoomFactor *= 0.75;
 		
-	renderCurrentPixmap();
+	renderCurrentView();
 }
 
 //----------------------------------------------------------------------
@@ -1127,7 +1552,7 @@ void MainWindow::zoomReset()
 {
 	zoomFactor = 1.;
 	
-	renderCurrentPixmap();
+	renderCurrentView();
 }
 
 //----------------------------------------------------------------------
@@ -21,8 +21,19 @@
 #define _MAINWINDOW_H
 
 #include <QtGui>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
 
 #include "animbar.h"
+#include "ImageLoader.h"
+#include "FrameStore.h"
+#include "PreviewCompositor.h"
+#include "SvgWriter.h"
+#include "ThumbnailCache.h"
+#include "ResultCache.h"
+
+class Composer;
+class TiledImageView;
 
 /* we want to use pointers to QImages as user defined data type in 
  * QVariants. See also constructor MainWindow::MainWindow().
@@ -44,12 +55,18 @@ protected:
 private slots:
 	/* the menu slots */
 	void openFile();
+	void openAnimation();
 	void saveBaseImage();
 	void saveBarMask();
     void saveAnimation();
     void exportAnimation();
 
 	void compute();
+	void setThreadCount();
+	void setResultCacheSize();
+	void setCompactSvg(bool);
+	void setPngCompression(QAction*);
+	void setFramesOnDisk(bool);
 	
 	void zoomIn();
 	void zoomOut();
@@ -60,6 +77,10 @@ private slots:
 	
 	/* the other slots */
 	void sliderChangedValue(int);
+	void computeFinished();
+	void openImageReady();
+	void openFinished();
+	void precomputePreview();
 	
 private:
 	/* private member functions */
@@ -70,12 +91,10 @@ private:
 
     /* documented in source code */
     bool getParameters(const QImage&, unsigned int&, unsigned int&);
-	
-    /* documented in source code */
-    bool xmlWriteImage(QXmlStreamWriter&, const QImage&, unsigned int) const;
-    bool xmlWriteAnimation(QXmlStreamWriter&, int, unsigned int, double) const;
 
-	void renderCurrentPixmap();
+	void renderCurrentView();
+	bool previewCacheAll() const;
+	SvgWriter::Style svgStyle() const;
 	
 	bool setupUI();
 	bool setupMenus();
@@ -83,18 +102,27 @@ private:
 	bool loadSettings();
 	bool saveSettings();
 	
+	void beginOpen(int);
+	
 	QImage* getImage(QListWidgetItem*);
 	QImage* getImage(int);
+	QSize getImageSize(int);
+	void deleteImage(QImage*);
+	bool decodeImages(const std::vector< QImage* >&);
+	bool waitForImages(QFuture< LoadedImage >, const std::vector< QImage* >&, const QList< QSize >&, QStringList&);
 	
 	QString getSupportedImageFormats() const;
 	
 	bool saveImage(const QImage&, const QString&);
 	
 	bool compute(const std::vector< QImage* >);
+	void showAnimation();
 	
 	/* private member variables */
 	QListWidget *imageList;
+	QScrollArea *scrollArea;
 	QLabel *imageLabel;
+	TiledImageView *imageView;
 	QSlider *slider;
 	
 	QDir openDir;
@@ -105,17 +133,69 @@ private:
 	
 	QImage baseImage;
 	QImage barMask;
-    QImage image;
 	
-	QPixmap currentPixmap;
+	/* the previews for the slider positions, see sliderChangedValue() */
+	PreviewCompositor preview;
+	QVector< QImage > previewImages;
+	
 	int stripWidth;
+	/* duration of the animation in seconds, 0 for one second per frame */
+	double animDuration;
 	double zoomFactor;
+	/* number of threads to compute on, 0 for one per core */
+	int threadCount;
+	/* the animations computed last, within resultCacheSize megabytes */
+	int resultCacheSize;
+	ResultCache resultCache;
+	/* write SVG files in SvgWriter::Compact style */
+	bool compactSvg;
+	QAction *compactSvgAction;
+	/* keep the input images in frameStore, see FrameStore */
+	bool framesOnDisk;
+	QAction *framesOnDiskAction;
+	FrameStore frameStore;
+	/* compression of all PNG images we write */
+	PngWriter::Compression pngCompression;
+	QActionGroup *pngCompressionActions;
 
     /*! In order to be able to save the animation with the complete original
      * images, we need to know from which images we computed the animation (in
      * case only a subset was selected. This selection is stored in here.
      */
     std::vector< QImage* > m_animationImages;
+    /*! QImage::cacheKey() of m_animationImages when the animation was
+     * computed, in the order of their strips. Tells which strips to
+     * rewrite after frames have been reordered or replaced.
+     */
+    std::vector< qint64 > m_animationKeys;
+
+    /*! The images being loaded in the background, see openFile(). Results
+     * before openNext have already been added to imageList.
+     */
+    QFutureWatcher< LoadedImage > openWatcher;
+    int openNext;
+    /*! The frames being loaded by openAnimation(), in the order of the
+     * results, empty when loading files.
+     */
+    QList< SvgFrame > openFrames;
+    QStringList openWarnings;
+    qint64 openDecodeTime;
+    qint64 openNormalizeTime;
+    QProgressBar *openProgress;
+    /*! Thumbnails of the images opened before, see ImageLoader */
+    ThumbnailCache thumbnailCache;
+
+    /*! The background computation of the animation, if any, see compute()
+     * and computeFinished(). m_computeImages become m_animationImages once
+     * the computation has finished successfully.
+     */
+    Composer *composer;
+    QFutureWatcher< bool > computeWatcher;
+    QElapsedTimer computeTimer;
+    std::vector< QImage* > m_computeImages;
+    std::vector< qint64 > m_computeKeys;
+    QProgressBar *computeProgress;
+    QPushButton *computeCancel;
 };
 
 #endif // _MAINWINDOWFORM_H
@@ -0,0 +1,259 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "MaskSelect.h"
+
+/* The SIMD kernels are built on x86 only. SSE2 is part of every x86-64
+ * processor; for 32 bit builds we still check at runtime. The AVX2 kernel
+ * needs a compiler that builds single functions for AVX2, see ANIMBAR_AVX2.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ANIMBAR_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ANIMBAR_SSE2_TARGET
+#define ANIMBAR_AVX2_TARGET
+#define ANIMBAR_AVX2
+#elif defined(__GNUC__)
+#define ANIMBAR_SSE2_TARGET __attribute__((target("sse2")))
+#define ANIMBAR_AVX2_TARGET __attribute__((target("avx2")))
+#if defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define ANIMBAR_AVX2
+#endif
+#include <cpuid.h>
+#endif
+#endif
+
+static const quint32 black = 0xff000000;
+
+//----------------------------------------------------------------------
+
+/* Select the pixels [from, to) bit by bit. */
+static inline void selectBits(const quint32* src, const uchar* mask, quint32* dst, int from, int to)
+{
+	for ( int x=from ; x<to ; x++ )
+		dst[x] = ((mask[x >> 3] >> (7 - (x & 7))) & 1) ? src[x] : black;
+}
+
+//----------------------------------------------------------------------
+
+/* Scalar kernel, whole mask bytes are copied or filled as a block. */
+static void selectRowScalar(const quint32* src, const uchar* mask, quint32* dst, int width)
+{
+	int x = 0;
+	for ( ; x+8<=width ; x+=8 ) {
+		uchar m = mask[x >> 3];
+		if (m == 0xff) memcpy(dst + x, src + x, 8 * sizeof(quint32));
+		else if (m == 0) std::fill(dst + x, dst + x + 8, black);
+		else selectBits(src, mask, dst, x, x + 8);
+	}
+	selectBits(src, mask, dst, x, width);
+}
+
+#ifdef ANIMBAR_X86
+
+//----------------------------------------------------------------------
+
+/* SSE2 kernel, one mask byte makes two pixel masks of four pixels each:
+ * the byte is broadcast to all lanes, each lane tests its bit.
+ */
+ANIMBAR_SSE2_TARGET
+static void selectRowSSE2(const quint32* src, const uchar* mask, quint32* dst, int width)
+{
+	const __m128i bitsHi = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+	const __m128i bitsLo = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+	const __m128i fill = _mm_set1_epi32((int) black);
+
+	int x = 0;
+	for ( ; x+8<=width ; x+=8 ) {
+		__m128i m = _mm_set1_epi32(mask[x >> 3]);
+		__m128i selHi = _mm_cmpeq_epi32(_mm_and_si128(m, bitsHi), bitsHi);
+		__m128i selLo = _mm_cmpeq_epi32(_mm_and_si128(m, bitsLo), bitsLo);
+
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + x));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + x + 4));
+		a = _mm_or_si128(_mm_and_si128(selHi, a), _mm_andnot_si128(selHi, fill));
+		b = _mm_or_si128(_mm_and_si128(selLo, b), _mm_andnot_si128(selLo, fill));
+		_mm_storeu_si128((__m128i*) (dst + x), a);
+		_mm_storeu_si128((__m128i*) (dst + x + 4), b);
+	}
+	selectBits(src, mask, dst, x, width);
+}
+
+#ifdef ANIMBAR_AVX2
+
+//----------------------------------------------------------------------
+
+/* AVX2 kernel, as the SSE2 one with eight pixels per mask byte. */
+ANIMBAR_AVX2_TARGET
+static void selectRowAVX2(const quint32* src, const uchar* mask, quint32* dst, int width)
+{
+	const __m256i bits = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+	const __m256i fill = _mm256_set1_epi32((int) black);
+
+	int x = 0;
+	for ( ; x+8<=width ; x+=8 ) {
+		__m256i m = _mm256_set1_epi32(mask[x >> 3]);
+		__m256i sel = _mm256_cmpeq_epi32(_mm256_and_si256(m, bits), bits);
+		__m256i a = _mm256_loadu_si256((const __m256i*) (src + x));
+		_mm256_storeu_si256((__m256i*) (dst + x), _mm256_blendv_epi8(fill, a, sel));
+	}
+	selectBits(src, mask, dst, x, width);
+}
+
+#endif // ANIMBAR_AVX2
+
+//----------------------------------------------------------------------
+
+/* cpuid leaf 1 edx, leaf 7 ebx and xgetbv, for the features we need. */
+static bool cpuHas(MaskSelect::Kernel kernel)
+{
+	unsigned int info[4] = { 0, 0, 0, 0 };
+
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	unsigned int maxLeaf = regs[0];
+	__cpuid(regs, 1);
+	for ( int i=0 ; i<4 ; i++ ) info[i] = regs[i];
+#else
+	unsigned int maxLeaf = __get_cpuid_max(0, NULL);
+	if (maxLeaf < 1) return false;
+	__cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+
+	if (kernel == MaskSelect::SSE2) return (info[3] & (1u << 26)) != 0;
+
+	/* AVX2 needs OSXSAVE and the OS saving the ymm registers */
+	if (maxLeaf < 7 || !(info[2] & (1u << 27)) || !(info[2] & (1u << 28))) return false;
+
+#if defined(_MSC_VER)
+	if ((_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	unsigned int xcr0Lo, xcr0Hi;
+	__asm__ __volatile__ ("xgetbv" : "=a" (xcr0Lo), "=d" (xcr0Hi) : "c" (0));
+	if ((xcr0Lo & 6) != 6) return false;
+	__cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+	return (info[1] & (1u << 5)) != 0;
+#endif
+}
+
+#endif // ANIMBAR_X86
+
+//----------------------------------------------------------------------
+
+/*! \brief Check if a kernel may be used on this machine
+ *
+ * That is, if it has been built and the processor supports it.
+ */
+bool MaskSelect::isSupported(Kernel kernel)
+{
+	switch (kernel) {
+	case Scalar:
+		return true;
+	case SSE2:
+#ifdef ANIMBAR_X86
+		return cpuHas(SSE2);
+#else
+		return false;
+#endif
+	case AVX2:
+#if defined(ANIMBAR_X86) && defined(ANIMBAR_AVX2)
+		return cpuHas(AVX2);
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief The best supported kernel, determined once */
+MaskSelect::Kernel MaskSelect::kernel()
+{
+	static const Kernel best =
+		isSupported(AVX2) ? AVX2 :
+		isSupported(SSE2) ? SSE2 :
+		Scalar;
+
+	return best;
+}
+
+//----------------------------------------------------------------------
+
+const char* MaskSelect::name(Kernel kernel)
+{
+	switch (kernel) {
+	case Scalar: return "scalar";
+	case SSE2: return "sse2";
+	case AVX2: return "avx2";
+	}
+
+	return "unknown";
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Select the pixels of a scanline with the best kernel
+ *
+ * \param src The scanline, opaque pixels
+ * \param mask The mask scanline, at least (width + 7) / 8 bytes
+ * \param dst The resulting scanline
+ * \param width Width of the scanlines in pixels
+ */
+void MaskSelect::selectRow(const quint32* src, const uchar* mask, quint32* dst, int width)
+{
+	selectRow(kernel(), src, mask, dst, width);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Select the pixels of a scanline with a given kernel
+ *
+ * The kernel must be supported, see isSupported(). This is meant for
+ * benchmarks and comparisons, use selectRow() otherwise.
+ */
+void MaskSelect::selectRow(Kernel kernel, const quint32* src, const uchar* mask, quint32* dst, int width)
+{
+	switch (kernel) {
+#ifdef ANIMBAR_X86
+	case SSE2:
+		selectRowSSE2(src, mask, dst, width);
+		return;
+#ifdef ANIMBAR_AVX2
+	case AVX2:
+		selectRowAVX2(src, mask, dst, width);
+		return;
+#endif
+#endif
+	default:
+		break;
+	}
+
+	selectRowScalar(src, mask, dst, width);
+}
@@ -0,0 +1,55 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MASKSELECT_H
+#define _MASKSELECT_H
+
+#include <QtGlobal>
+
+/*! \brief Selects pixels of a scanline by a 1-bpp mask
+ *
+ * This is the multiplication of an opaque scanline with a black and white
+ * mask: where the mask bit is set, the pixel is kept, elsewhere it becomes
+ * opaque black. The mask is packed most significant bit first, as
+ * QImage::Format_Mono.
+ *
+ * There are SSE2 and AVX2 kernels that expand mask bits to pixel masks in
+ * registers, and a scalar one. The best kernel the processor supports is
+ * chosen on first use.
+ */
+class MaskSelect
+{
+public:
+	/*! The kernels, see kernel() */
+	enum Kernel {
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	/* documented in source code */
+	static void selectRow(const quint32*, const uchar*, quint32*, int);
+	static void selectRow(Kernel, const quint32*, const uchar*, quint32*, int);
+
+	static Kernel kernel();
+	static bool isSupported(Kernel);
+	static const char* name(Kernel);
+};
+
+#endif // _MASKSELECT_H
@@ -0,0 +1,121 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFileInfo>
+#include <QImageWriter>
+
+#include "PngWriter.h"
+#include "Trace.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Write an image as PNG file to a device
+ *
+ * \param image The image
+ * \param device Device to write to, already open for writing
+ * \param compression The compression to use
+ *
+ * \return False, if writing failed.
+ */
+bool PngWriter::save(const QImage& image, QIODevice* device, Compression compression)
+{
+	QImageWriter writer(device, "PNG");
+	writer.setQuality(quality(compression));
+	return writer.write(image);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write an image to a file
+ *
+ * As QImage::save(), the file type is determined by the file name's
+ * ending. The compression only applies to PNG files, other file types are
+ * written with Qt's default quality.
+ *
+ * \param image The image
+ * \param fileName Name of the file to write
+ * \param compression The compression to use for PNG files
+ *
+ * \return False, if writing failed.
+ */
+bool PngWriter::save(const QImage& image, const QString& fileName, Compression compression)
+{
+	TraceSpan span("saveImage");
+
+	QImageWriter writer(fileName);
+	if (QFileInfo(fileName).suffix().toLower() == "png")
+		writer.setQuality(quality(compression));
+	bool ok = writer.write(image);
+
+	if (Trace::isEnabled()) span.setBytes(QFileInfo(fileName).size());
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief The QImageWriter quality for a compression
+ *
+ * Qt's PNG handler uses the zlib level (100 - quality) * 9 / 91, and zlib's
+ * default for negative qualities.
+ */
+int PngWriter::quality(Compression compression)
+{
+	switch (compression) {
+	case Fast: return 89;
+	case Small: return 0;
+	case Default: break;
+	}
+
+	return -1;
+}
+
+//----------------------------------------------------------------------
+
+QString PngWriter::toString(Compression compression)
+{
+	switch (compression) {
+	case Fast: return "fast";
+	case Small: return "small";
+	case Default: break;
+	}
+
+	return "default";
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Parse the names of toString()
+ *
+ * \param name "fast", "default" or "small"
+ * \param ok (out) If given, set to false if name is unknown
+ *
+ * \return The compression, Default if name is unknown.
+ */
+PngWriter::Compression PngWriter::fromString(const QString& name, bool* ok)
+{
+	if (ok) *ok = true;
+
+	if (name == "fast") return Fast;
+	if (name == "small") return Small;
+	if (name == "default") return Default;
+
+	if (ok) *ok = false;
+	return Default;
+}
@@ -0,0 +1,56 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PNGWRITER_H
+#define _PNGWRITER_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+
+/*! \brief Writes images with a chosen PNG compression
+ *
+ * Qt's PNG handler maps the writer's quality to the zlib compression level,
+ * see QImageWriter::setQuality(). The filter strategy is chosen by libpng
+ * and not exposed by Qt.
+ */
+class PngWriter
+{
+public:
+	/*! Trade-off between encoding time and file size */
+	enum Compression {
+		/*! zlib level 1 */
+		Fast,
+		/*! Qt's default, zlib level 6 */
+		Default,
+		/*! zlib level 9 */
+		Small
+	};
+
+	/* documented in source code */
+	static bool save(const QImage&, QIODevice*, Compression);
+	static bool save(const QImage&, const QString&, Compression);
+
+	static int quality(Compression);
+
+	static QString toString(Compression);
+	static Compression fromString(const QString&, bool* = NULL);
+};
+
+#endif // _PNGWRITER_H
@@ -0,0 +1,254 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "BarMask.h"
+#include "MaskSelect.h"
+#include "PreviewCompositor.h"
+#include "Trace.h"
+
+/* Below this strip width, a scanline has so many short runs that selecting
+ * pixels by a mask scanline beats copying the runs one by one.
+ */
+static const int maskSelectStripWidth = 16;
+
+//----------------------------------------------------------------------
+
+PreviewCompositor::PreviewCompositor() : m_stripWidth(1), m_nrFrames(0), m_black(0)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the base image to render previews of
+ *
+ * QPainter::CompositionMode_Multiply of a translucent base pixel with a
+ * white mask pixel gives the base pixel composited onto white. If the base
+ * image has such pixels, we do that composition once here, so render()
+ * only needs to select between base pixel and black.
+ *
+ * Monochrome and indexed base images are rendered to indexed previews,
+ * one byte per pixel. Their colors are composited onto white in the color
+ * table, which also gets an entry for black, if it has none. Only if there
+ * is no room for it, we fall back to full color.
+ *
+ * \param base The base image
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ */
+void PreviewCompositor::setBase(const QImage& base, int stripWidth, int nrFrames)
+{
+	m_stripWidth = stripWidth;
+	m_nrFrames = nrFrames;
+
+	if (setIndexedBase(base)) return;
+
+	if (base.format() == QImage::Format_ARGB32_Premultiplied) m_base = base;
+	else m_base = base.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+	/* look for translucent pixels */
+	bool opaque = true;
+	for ( int row=0 ; row<m_base.height() && opaque ; row++ ) {
+		const quint32 *line = (const quint32*) m_base.constScanLine(row);
+		for ( int col=0 ; col<m_base.width() ; col++ )
+			if (qAlpha(line[col]) != 255) {
+				opaque = false;
+				break;
+			}
+	}
+	if (opaque) return;
+
+	/* composite onto white: c' = c + (255 - alpha) for premultiplied c */
+	for ( int row=0 ; row<m_base.height() ; row++ ) {
+		quint32 *line = (quint32*) m_base.scanLine(row);
+		for ( int col=0 ; col<m_base.width() ; col++ ) {
+			int t = 255 - qAlpha(line[col]);
+			line[col] = qRgba(
+				qRed(line[col]) + t,
+				qGreen(line[col]) + t,
+				qBlue(line[col]) + t,
+				255);
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+
+/* The indexed part of setBase(). Returns false, if base is neither
+ * monochrome nor indexed or its color table is full without black.
+ */
+bool PreviewCompositor::setIndexedBase(const QImage& base)
+{
+	if (base.format() != QImage::Format_Indexed8 &&
+		base.format() != QImage::Format_Mono &&
+		base.format() != QImage::Format_MonoLSB)
+		return false;
+
+	/* composite the colors onto white, c' = c * a + (255 - a) */
+	QVector< QRgb > colorTable = base.colorTable();
+	for ( int i=0 ; i<colorTable.size() ; i++ ) {
+		QRgb c = colorTable[i];
+		int a = qAlpha(c);
+		colorTable[i] = qRgb(
+			qRed(c) * a / 255 + 255 - a,
+			qGreen(c) * a / 255 + 255 - a,
+			qBlue(c) * a / 255 + 255 - a);
+	}
+
+	int black = colorTable.indexOf(qRgb(0, 0, 0));
+	if (black < 0) {
+		if (colorTable.size() >= 256) return false;
+		black = colorTable.size();
+		colorTable.append(qRgb(0, 0, 0));
+	}
+
+	if (base.format() == QImage::Format_Indexed8) m_base = base;
+	else m_base = base.convertToFormat(QImage::Format_Indexed8);
+	m_base.setColorTable(colorTable);
+	m_black = black;
+
+	return true;
+}
+//----------------------------------------------------------------------
+
+void PreviewCompositor::clear()
+{
+	m_base = QImage();
+	m_nrFrames = 0;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Render the preview for a slider position
+ *
+ * \param idx Slider position, 0 gives the (flattened) base image, 1 to
+ *  nrFrames() show the mask shifted by idx - 1 strips.
+ *
+ * \return The preview image, a null image for an invalid position.
+ */
+QImage PreviewCompositor::render(int idx) const
+{
+	if (m_base.isNull() || idx < 0 || idx > m_nrFrames) return QImage();
+	if (idx == 0) return m_base;
+
+	TraceSpan span("renderPreview");
+
+	QImage result(m_base.size(), m_base.format());
+	if (result.isNull()) return result;
+	span.setBytes(result.byteCount());
+
+	int offset = m_stripWidth * (idx - 1);
+
+	if (m_base.format() == QImage::Format_Indexed8) {
+		result.setColorTable(m_base.colorTable());
+		for ( int row=0 ; row<m_base.height() ; row++ )
+			renderRow8(
+				m_base.constScanLine(row),
+				result.scanLine(row),
+				m_base.width(),
+				offset,
+				m_stripWidth,
+				m_nrFrames,
+				m_black);
+		return result;
+	}
+
+	if (m_stripWidth < maskSelectStripWidth) {
+		/* every row sees the same mask scanline */
+		int bytesPerLine = (m_base.width() + 7) / 8;
+		QVector< uchar > mask(bytesPerLine);
+		BarMask::fillRow(mask.data(), bytesPerLine, m_base.width(), m_stripWidth, m_nrFrames, offset);
+
+		for ( int row=0 ; row<m_base.height() ; row++ )
+			MaskSelect::selectRow(
+				(const quint32*) m_base.constScanLine(row),
+				mask.constData(),
+				(quint32*) result.scanLine(row),
+				m_base.width());
+		return result;
+	}
+
+	for ( int row=0 ; row<m_base.height() ; row++ )
+		renderRow(
+			(const quint32*) m_base.constScanLine(row),
+			(quint32*) result.scanLine(row),
+			m_base.width(),
+			offset,
+			m_stripWidth,
+			m_nrFrames);
+
+	return result;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Render one scanline of a preview
+ *
+ * The mask, shifted by offset pixels, is transparent for the columns
+ * [offset + k * stripWidth * nrFrames, offset + k * stripWidth * nrFrames
+ * + stripWidth). These runs are copied from the base image, all other
+ * columns are black.
+ *
+ * \param src Scanline of the base image
+ * \param dst Scanline of the preview
+ * \param width Width of the scanlines in pixels
+ * \param offset Shift of the mask in pixels
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ */
+void PreviewCompositor::renderRow(
+	const quint32* src,
+	quint32* dst,
+	int width,
+	int offset,
+	int stripWidth,
+	int nrFrames)
+{
+	std::fill(dst, dst + width, (quint32) 0xff000000);
+
+	int period = stripWidth * nrFrames;
+	for ( int col=offset ; col<width ; col+=period ) {
+		int n = qMin(stripWidth, width - col);
+		memcpy(dst + col, src + col, n * sizeof(quint32));
+	}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Render one scanline of an indexed preview
+ *
+ * See renderRow(), the columns outside the runs are set to index black.
+ */
+void PreviewCompositor::renderRow8(
+	const uchar* src,
+	uchar* dst,
+	int width,
+	int offset,
+	int stripWidth,
+	int nrFrames,
+	uchar black)
+{
+	memset(dst, black, width);
+
+	int period = stripWidth * nrFrames;
+	for ( int col=offset ; col<width ; col+=period )
+		memcpy(dst + col, src + col, qMin(stripWidth, width - col));
+}
@@ -0,0 +1,67 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PREVIEWCOMPOSITOR_H
+#define _PREVIEWCOMPOSITOR_H
+
+#include <QImage>
+
+/*! \brief Renders the base image as seen through the shifted bar mask
+ *
+ * For slider position idx > 0, the bar mask is shifted by
+ * stripWidth * (idx - 1) pixels to the right, the uncovered columns to its
+ * left are black. Multiplying the base image with it keeps a base pixel
+ * where the shifted mask is transparent and turns it black elsewhere.
+ * Instead of generic compositing, we derive the transparent columns
+ * directly from the strip layout and copy them as runs. For narrow strips,
+ * the shifted mask scanline is built once and applied with MaskSelect.
+ */
+class PreviewCompositor
+{
+public:
+	PreviewCompositor();
+
+	/* documented in source code */
+	void setBase(const QImage&, int, int);
+	void clear();
+
+	int nrFrames() const { return m_nrFrames; }
+	/*! The format of the rendered previews, see m_base */
+	QImage::Format format() const { return m_base.format(); }
+
+	QImage render(int) const;
+
+	static void renderRow(const quint32*, quint32*, int, int, int, int);
+	static void renderRow8(const uchar*, uchar*, int, int, int, int, uchar);
+
+private:
+	bool setIndexedBase(const QImage&);
+
+	/* the base image, flattened onto white if it has translucent pixels
+	 * just as the multiplication with the white mask strips would do.
+	 * Either QImage::Format_ARGB32_Premultiplied or
+	 * QImage::Format_Indexed8 with m_black the index of black.
+	 */
+	QImage m_base;
+	int m_stripWidth;
+	int m_nrFrames;
+	int m_black;
+};
+
+#endif // _PREVIEWCOMPOSITOR_H
@@ -0,0 +1,106 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <climits>
+
+#include <QStringList>
+
+#include "ResultCache.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Create a cache of maxBytes bytes, see setMaxBytes() */
+ResultCache::ResultCache(qint64 maxBytes)
+{
+	setMaxBytes(maxBytes);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the budget of the cache
+ *
+ * Results are dropped, least recently used first, until the cache fits.
+ * A result larger than the budget is not kept at all, so zero disables
+ * the cache.
+ */
+void ResultCache::setMaxBytes(qint64 maxBytes)
+{
+	m_cache.setMaxCost((int) qBound((qint64) 0, maxBytes / 1024, (qint64) INT_MAX));
+}
+
+//----------------------------------------------------------------------
+
+qint64 ResultCache::maxBytes() const
+{
+	return (qint64) m_cache.maxCost() * 1024;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Look up the animation of frameKeys and stripWidth
+ *
+ * \param frameKeys QImage::cacheKey() of the frames, in the order of the
+ *  animation
+ * \param stripWidth Strip width in pixels
+ * \param baseImage (out) The base image, if found
+ * \param barMask (out) The bar mask, if found
+ *
+ * \return True, if the animation has been found. It is the most recently
+ *  used one then.
+ */
+bool ResultCache::find(const std::vector< qint64 >& frameKeys, int stripWidth, QImage& baseImage, QImage& barMask)
+{
+	Result *result = m_cache.object(key(frameKeys, stripWidth));
+	if (!result) return false;
+
+	baseImage = result->baseImage;
+	barMask = result->barMask;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Add the animation of frameKeys and stripWidth
+ *
+ * See find() for frameKeys. The images are shallow copies, they share their pixels with the caller's.
+ */
+void ResultCache::insert(const std::vector< qint64 >& frameKeys, int stripWidth, const QImage& baseImage, const QImage& barMask)
+{
+	Result *result = new Result;
+	result->baseImage = baseImage;
+	result->barMask = barMask;
+
+	int cost = (int) qMin(((qint64) baseImage.byteCount() + barMask.byteCount() + 1023) / 1024, (qint64) INT_MAX);
+
+	/* QCache takes ownership, also if the result is too large */
+	m_cache.insert(key(frameKeys, stripWidth), result, cost);
+}
+
+//----------------------------------------------------------------------
+
+/* The strip width and the cache keys of the frames, in order. */
+QString ResultCache::key(const std::vector< qint64 >& frameKeys, int stripWidth)
+{
+	QStringList keys;
+	keys << QString::number(stripWidth);
+	for ( unsigned int i=0 ; i<frameKeys.size() ; i++ ) keys << QString::number(frameKeys[i]);
+
+	return keys.join(",");
+}
@@ -0,0 +1,64 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RESULTCACHE_H
+#define _RESULTCACHE_H
+
+#include <vector>
+
+#include <QCache>
+#include <QImage>
+#include <QString>
+
+/*! \brief Keeps recently computed animations
+ *
+ * Base image and bar mask only depend on the frames, their order and the
+ * strip width. A frame is identified by QImage::cacheKey(), which is
+ * unique for every image and changes if the image is modified. Callers
+ * pass the keys, taken while the frames are known to exist. Results
+ * are kept within a budget of bytes, the least recently used ones are
+ * dropped first.
+ */
+class ResultCache
+{
+public:
+	/* documented in source code */
+	ResultCache(qint64 = 0);
+
+	void setMaxBytes(qint64);
+	qint64 maxBytes() const;
+
+	bool find(const std::vector< qint64 >&, int, QImage&, QImage&);
+	void insert(const std::vector< qint64 >&, int, const QImage&, const QImage&);
+	void clear() { m_cache.clear(); }
+
+private:
+	struct Result
+	{
+		QImage baseImage;
+		QImage barMask;
+	};
+
+	static QString key(const std::vector< qint64 >&, int);
+
+	/* costs are in kilobytes, QCache counts in int */
+	QCache< QString, Result > m_cache;
+};
+
+#endif // _RESULTCACHE_H
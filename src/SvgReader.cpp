@@ -0,0 +1,206 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QStringList>
+
+#include "SvgReader.h"
+
+static const char* xlinkNamespace = "http://www.w3.org/1999/xlink";
+
+//----------------------------------------------------------------------
+
+/*! \brief Decode the frame's image file
+ *
+ * \return The image, a null image if decoding failed.
+ */
+QImage SvgFrame::decode() const
+{
+	return QImage::fromData(QByteArray::fromBase64(data));
+}
+
+//----------------------------------------------------------------------
+
+SvgReader::SvgReader() : m_stripWidth(0), m_duration(-1.), m_patternStripWidth(0)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Read an animation
+ *
+ * The strip width is not stored as such. saveAnimation() places frame i at
+ * x = i * (width - stripWidth), so we take it from the second frame. The
+ * animateMotion values shift every frame by its full width, they only
+ * tell us whether the file holds frames at all, see ExportedAnimation.
+ * With a single frame, the bar mask is transparent all over and the strip
+ * width does not matter. Only the bar pattern of compact files keeps it,
+ * otherwise stripWidth() is zero.
+ *
+ * \param device Device to read from, already open for reading
+ * \param name Name of the file, frames are named after it
+ *
+ * \return NoError if the animation was read and the reason of failure
+ *  otherwise, see errorString().
+ */
+SvgReader::Error SvgReader::read(QIODevice* device, const QString& name)
+{
+	m_frames.clear();
+	m_deltas.clear();
+	m_stripWidth = 0;
+	m_duration = -1.;
+	m_patternStripWidth = 0;
+
+	QXmlStreamReader xml(device);
+
+	if (!xml.readNextStartElement()) return NotWellFormed;
+	if (xml.name() != "svg") return NoSvg;
+
+	while (!xml.atEnd()) {
+		xml.readNext();
+		if (!xml.isStartElement()) continue;
+
+		if (xml.name() == "image") readImage(xml, name);
+		else if (xml.name() == "pattern" && xml.attributes().value("id") == "barPattern") readPattern(xml);
+	}
+
+	if (xml.hasError()) return NotWellFormed;
+	if (m_frames.isEmpty()) return NoFrames;
+
+	/* an exported animation has a single image, the base image, that moves
+	 * by the strip width instead of its width.
+	 */
+	QSize size = m_frames[0].size;
+	if (m_frames.size() == 1 && m_deltas[0] != size.width()) return ExportedAnimation;
+
+	for ( int i=0 ; i<m_frames.size() ; i++ )
+		if (m_frames[i].size != size || m_frames[i].size.isEmpty() || m_frames[i].data.isEmpty())
+			return InvalidFrames;
+
+	if (m_frames.size() == 1) {
+		if (m_patternStripWidth <= size.width()) m_stripWidth = m_patternStripWidth;
+		return NoError;
+	}
+
+	m_stripWidth = size.width() - m_frames[1].x;
+
+	if (m_stripWidth <= 0 || m_stripWidth > size.width()) {
+		m_stripWidth = 0;
+		return NoStripWidth;
+	}
+
+	return NoError;
+}
+
+//----------------------------------------------------------------------
+
+/* Read an image element, a frame or the bar mask. The reader is on the
+ * start element and left on its end element.
+ */
+void SvgReader::readImage(QXmlStreamReader& xml, const QString& name)
+{
+	QXmlStreamAttributes attributes = xml.attributes();
+
+	SvgFrame frame;
+	frame.size = QSize(
+		attributes.value("width").toString().toInt(),
+		attributes.value("height").toString().toInt());
+	frame.x = attributes.value("x").toString().toInt();
+	frame.data = imageData(attributes.value(xlinkNamespace, "href"));
+
+	/* only frames are animated */
+	bool animated = false;
+	int delta = 0;
+	while (xml.readNextStartElement()) {
+		if (xml.name() == "animateMotion") {
+			animated = true;
+
+			/* values are "0,0;-delta,0;-2*delta,0;...", one per frame. A
+			 * single value is only written for one-frame animations, whose
+			 * image is the frame itself.
+			 */
+			QStringList values = xml.attributes().value("values").toString().split(';', QString::SkipEmptyParts);
+			if (values.size() > 1) delta = -values[1].section(',', 0, 0).toInt();
+			else if (values.size() == 1) delta = frame.size.width();
+
+			QString duration = xml.attributes().value("dur").toString();
+			if (duration.endsWith('s')) duration.chop(1);
+			bool ok;
+			double d = duration.toDouble(&ok);
+			if (ok) m_duration = d;
+		}
+		xml.skipCurrentElement();
+	}
+
+	/* the bar mask is not animated */
+	if (!animated) return;
+
+	frame.name = QString("%1 [%2]").arg(name).arg(m_frames.size() + 1);
+	m_frames.append(frame);
+	m_deltas.append(delta);
+}
+
+//----------------------------------------------------------------------
+
+/* Read the bar pattern of SvgWriter::Compact files, its opaque rectangle
+ * starts after the transparent strip.
+ */
+void SvgReader::readPattern(QXmlStreamReader& xml)
+{
+	while (xml.readNextStartElement()) {
+		if (xml.name() == "rect")
+			m_patternStripWidth = xml.attributes().value("x").toString().toInt();
+		xml.skipCurrentElement();
+	}
+}
+
+//----------------------------------------------------------------------
+
+/* The base64 data of a data URI, empty if it is none. */
+QByteArray SvgReader::imageData(const QStringRef& href)
+{
+	QString uri = href.toString();
+	if (!uri.startsWith("data:image/")) return QByteArray();
+
+	int start = uri.indexOf(";base64,");
+	if (start < 0) return QByteArray();
+
+	return uri.mid(start + 8).toLatin1();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Describe why read() failed
+ *
+ * The descriptions are marked for translation in the context "SvgReader",
+ * translate them with QCoreApplication::translate().
+ */
+const char* SvgReader::errorString(Error error)
+{
+	switch (error) {
+	case NoError: return QT_TRANSLATE_NOOP("SvgReader", "The animation has been read.");
+	case NotWellFormed: return QT_TRANSLATE_NOOP("SvgReader", "The SVG file is not well-formed.");
+	case NoSvg: return QT_TRANSLATE_NOOP("SvgReader", "The file is no SVG file.");
+	case NoFrames: return QT_TRANSLATE_NOOP("SvgReader", "The SVG file holds no animation frames.");
+	case ExportedAnimation: return QT_TRANSLATE_NOOP("SvgReader", "The SVG file holds an exported animation, which can't be loaded again. Please use an animation saved with File -> Save Animation.");
+	case InvalidFrames: return QT_TRANSLATE_NOOP("SvgReader", "The SVG file holds frames of different or invalid size.");
+	case NoStripWidth: return QT_TRANSLATE_NOOP("SvgReader", "The strip width of the animation could not be determined.");
+	}
+
+	return QT_TRANSLATE_NOOP("SvgReader", "The SVG file could not be read.");
+}
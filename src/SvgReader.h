@@ -0,0 +1,106 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SVGREADER_H
+#define _SVGREADER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QIODevice>
+#include <QList>
+#include <QSize>
+#include <QString>
+#include <QXmlStreamReader>
+
+/*! \brief A frame of an SVG animation, not decoded yet
+ *
+ * Holds the base64 encoded image file as found in the SVG file. Copies are
+ * cheap, the encoded data is implicitly shared.
+ */
+struct SvgFrame
+{
+	SvgFrame() : x(0) {}
+
+	/* documented in source code */
+	QImage decode() const;
+
+	/*! Name of the frame for display, the file name and its number */
+	QString name;
+	QSize size;
+	/*! The frame's x attribute, see SvgWriter::saveAnimation() */
+	int x;
+	/*! The base64 encoded image file */
+	QByteArray data;
+};
+
+/*! \brief Reads animations saved by SvgWriter::saveAnimation()
+ *
+ * The file is read with a QXmlStreamReader in a single pass. Frames are
+ * the image elements with an animateMotion child, their image files are
+ * kept encoded, so reading is quick even for large animations. Decoding is
+ * up to the caller, see SvgFrame::decode().
+ *
+ * Files written by SvgWriter::exportAnimation() hold the base image only
+ * and are rejected.
+ */
+class SvgReader
+{
+public:
+	/*! Reasons why read() failed */
+	enum Error {
+		NoError = 0,
+		NotWellFormed,
+		NoSvg,
+		NoFrames,
+		ExportedAnimation,
+		InvalidFrames,
+		NoStripWidth
+	};
+
+	SvgReader();
+
+	/* documented in source code */
+	Error read(QIODevice*, const QString& = QString());
+	static const char* errorString(Error);
+
+	/*! The frames, in the order of the animation */
+	const QList< SvgFrame >& frames() const { return m_frames; }
+	/*! The strip width in pixels, valid after a successful read(). Zero
+	 * for one-frame animations that do not tell it, see read().
+	 */
+	int stripWidth() const { return m_stripWidth; }
+	/*! Duration of one animation cycle in seconds, negative if unknown */
+	double duration() const { return m_duration; }
+
+private:
+	void readImage(QXmlStreamReader&, const QString&);
+	void readPattern(QXmlStreamReader&);
+
+	static QByteArray imageData(const QStringRef&);
+
+	QList< SvgFrame > m_frames;
+	int m_stripWidth;
+	double m_duration;
+	/* deltas of the frames' animateMotion values */
+	QList< int > m_deltas;
+	/* the strip width of the bar pattern, see SvgWriter::Compact */
+	int m_patternStripWidth;
+};
+
+#endif // _SVGREADER_H
@@ -0,0 +1,390 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QBuffer>
+#include <QColor>
+#include <QVector>
+#include <QList>
+#include <QtConcurrentRun>
+
+#include "SvgWriter.h"
+#include "Base64Device.h"
+#include "Trace.h"
+
+//----------------------------------------------------------------------
+
+/*! \brief Save an animation to an SVG file
+ *
+ * The animation is saved in such a way, that it may be rendered by viewing
+ * the SVG file in any modern browser. Moreover, the animation shall be
+ * loadable to animbar for further edit, so we write the complete frames
+ * rather than the base image.
+ *
+ * \param device Device to write to, already open for writing
+ * \param frames The frames the animation was computed from
+ * \param barMask The bar mask image
+ * \param stripWidth Strip width in pixels
+ * \param duration Duration of one animation cycle in seconds
+ * \param style Formatted or Compact, see xmlWriteBarPattern()
+ * \param compression Compression of the embedded PNG files
+ *
+ * \return False, if writing failed.
+ */
+bool SvgWriter::saveAnimation(
+	QIODevice* device,
+	const std::vector< QImage* >& frames,
+	const QImage& barMask,
+	unsigned int stripWidth,
+	double duration,
+	Style style,
+	PngWriter::Compression compression)
+{
+	TraceSpan span("saveAnimation");
+
+	unsigned int nrFrames = frames.size();
+
+	QXmlStreamWriter xmlOutput(device);
+	xmlOutput.setAutoFormatting(style == Formatted);
+
+	xmlWriteHeader(xmlOutput, barMask.size());
+
+	/* Write complete images before the bar mask. PNG compression is by far
+	 * the most expensive part, so the next frame is encoded on the global
+	 * thread pool while we write the current one. We thus hold at most two
+	 * encoded PNG files plus the small buffer of Base64Device, no matter
+	 * how many threads there are. The frames are shared, not copied, by
+	 * the encoding tasks. Frames are written in order, so the file does
+	 * not depend on the number of threads.
+	 */
+	const unsigned int window = 2;
+	QList< QFuture< QByteArray > > encoded;
+	unsigned int nrStarted = 0;
+
+	bool ok = true;
+	for ( unsigned int i=0 ; i<nrFrames ; i++ ) {
+		while (nrStarted < nrFrames && nrStarted < i + window) {
+			encoded.append(QtConcurrent::run(encodePng, *frames[nrStarted], compression));
+			nrStarted++;
+		}
+
+		QByteArray png = encoded.takeFirst().result();
+
+		xmlWriteImageStart(xmlOutput, frames[i]->size(), i*(frames[i]->width() - stripWidth));
+		ok = xmlWritePng(xmlOutput, png) && ok;
+		xmlWriteAnimation(xmlOutput, frames[i]->width(), nrFrames, duration);
+		xmlOutput.writeEndElement();
+		xmlOutput.writeEndElement();
+	}
+
+	if (style == Compact) xmlWriteBarPattern(xmlOutput, barMask, stripWidth, nrFrames);
+	else ok = xmlWriteBarMask(xmlOutput, barMask, compression) && ok;
+
+	/* epilog */
+	xmlOutput.writeEndElement();        // svg
+	xmlOutput.writeEndDocument();
+
+	return ok && !xmlOutput.hasError();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Export an animation to an SVG file
+ *
+ * In contrast to saveAnimation(), we write the base image instead of the
+ * frames, so the animation can't be loaded into animbar again.
+ *
+ * \param device Device to write to, already open for writing
+ * \param baseImage The base image
+ * \param barMask The bar mask image
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ * \param duration Duration of one animation cycle in seconds
+ * \param style Formatted or Compact, see xmlWriteBarPattern()
+ * \param compression Compression of the embedded PNG files
+ *
+ * \return False, if writing failed.
+ */
+bool SvgWriter::exportAnimation(
+	QIODevice* device,
+	const QImage& baseImage,
+	const QImage& barMask,
+	unsigned int stripWidth,
+	unsigned int nrFrames,
+	double duration,
+	Style style,
+	PngWriter::Compression compression)
+{
+	TraceSpan span("exportAnimation");
+
+	QXmlStreamWriter xmlOutput(device);
+	xmlOutput.setAutoFormatting(style == Formatted);
+
+	xmlWriteHeader(xmlOutput, barMask.size());
+
+	/* write complete images before the bar mask */
+
+	bool ok = xmlWriteImage(xmlOutput, baseImage, 0, compression);
+	xmlWriteAnimation(xmlOutput, stripWidth, nrFrames, duration);
+	xmlOutput.writeEndElement();
+	xmlOutput.writeEndElement();
+
+	if (style == Compact) xmlWriteBarPattern(xmlOutput, barMask, stripWidth, nrFrames);
+	else ok = xmlWriteBarMask(xmlOutput, barMask, compression) && ok;
+
+	/* epilog */
+	xmlOutput.writeEndElement();        // svg
+	xmlOutput.writeEndDocument();
+
+	return ok && !xmlOutput.hasError();
+}
+
+//----------------------------------------------------------------------
+
+/* Start the document and the svg element. */
+void SvgWriter::xmlWriteHeader(QXmlStreamWriter& xmlOutput, const QSize& size)
+{
+	xmlOutput.writeStartDocument("1.0", false);
+	xmlOutput.writeDTD("<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\" \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">");
+
+	xmlOutput.writeStartElement("svg");
+	xmlOutput.writeAttribute("xmlns", "http://www.w3.org/2000/svg");
+	xmlOutput.writeAttribute("xmlns:xlink", "http://www.w3.org/1999/xlink");
+	xmlOutput.writeAttribute("version", "1.1");
+	xmlOutput.writeAttribute("width", QString::number(size.width()));
+	xmlOutput.writeAttribute("height", QString::number(size.height()));
+}
+
+//----------------------------------------------------------------------
+
+/* We write a copy of barMask, that has the white color replaced by a
+ * fully transparent color.
+ */
+bool SvgWriter::xmlWriteBarMask(QXmlStreamWriter& xmlOutput, const QImage& barMask, PngWriter::Compression compression)
+{
+	QImage barMaskCopy = barMask;
+	QVector< QRgb > colorTable = barMaskCopy.colorTable();
+	colorTable[1] = QColor(255,255,255,0).rgba();
+	barMaskCopy.setColorTable(colorTable);
+	bool ok = xmlWriteImage(xmlOutput, barMaskCopy, 0, compression);
+	xmlOutput.writeEndElement();
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write the bar mask as a stripe pattern
+ *
+ * All the bar mask's rows are the same and periodic, so instead of an
+ * embedded image of the full size we define a pattern of one period,
+ * stripWidth * nrFrames pixels wide, that holds a single opaque rectangle
+ * in the color of the mask's index 0. The transparent strip of a period
+ * comes first, as in BarMask. A rectangle of the mask's size is filled
+ * with the pattern. The edges are pixel aligned, we ask for crisp edges
+ * to keep renderers from anti-aliasing them.
+ *
+ * \param xmlOutput
+ * \param barMask The bar mask image, only its size and colors are used
+ * \param stripWidth Strip width in pixels
+ * \param nrFrames Number of frames
+ */
+void SvgWriter::xmlWriteBarPattern(
+	QXmlStreamWriter& xmlOutput,
+	const QImage& barMask,
+	unsigned int stripWidth,
+	unsigned int nrFrames)
+{
+	unsigned int period = stripWidth * nrFrames;
+	QString height = QString::number(barMask.height());
+
+	QColor color(Qt::black);
+	if (barMask.colorCount() > 0) color = QColor(barMask.color(0));
+
+	xmlOutput.writeStartElement("defs");
+	xmlOutput.writeStartElement("pattern");
+	xmlOutput.writeAttribute("id", "barPattern");
+	xmlOutput.writeAttribute("patternUnits", "userSpaceOnUse");
+	xmlOutput.writeAttribute("width", QString::number(period));
+	xmlOutput.writeAttribute("height", height);
+	xmlOutput.writeStartElement("rect");
+	xmlOutput.writeAttribute("x", QString::number(stripWidth));
+	xmlOutput.writeAttribute("width", QString::number(period - stripWidth));
+	xmlOutput.writeAttribute("height", height);
+	xmlOutput.writeAttribute("fill", color.name());
+	xmlOutput.writeAttribute("shape-rendering", "crispEdges");
+	xmlOutput.writeEndElement();        // rect
+	xmlOutput.writeEndElement();        // pattern
+	xmlOutput.writeEndElement();        // defs
+
+	xmlOutput.writeStartElement("rect");
+	xmlOutput.writeAttribute("id", "barMask");
+	xmlOutput.writeAttribute("width", QString::number(barMask.width()));
+	xmlOutput.writeAttribute("height", height);
+	xmlOutput.writeAttribute("fill", "url(#barPattern)");
+	xmlOutput.writeEndElement();        // rect
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write image in base64 encoded PNG format
+ *
+ * SVG files support embedding of images as base64 encoded PNG files. This
+ * method writes an entire SVG image tag with the image file as xlink.
+ * We do not end the element, so the caller must call
+ *      xmlOutput.writeEndElement();
+ * sooner or later.
+ *
+ * The PNG file is not built in memory. QXmlStreamWriter writes everything
+ * to its device right away and keeps the start tag open until the next
+ * element or end tag, so we write the xlink:href attribute ourselves: the
+ * PNG encoder writes to a Base64Device that in turn writes to the writer's
+ * device in small chunks. Writers without a device (writing to a QString)
+ * get the attribute the usual way.
+ *
+ * \param xmlOutput
+ * \param image
+ * \param x0
+ * \param compression
+ *
+ * \return False, if the image could not be written.
+ */
+bool SvgWriter::xmlWriteImage(
+	QXmlStreamWriter& xmlOutput,
+	const QImage& image,
+	unsigned int x0,
+	PngWriter::Compression compression)
+{
+	TraceSpan span("xmlWriteImage");
+
+	xmlWriteImageStart(xmlOutput, image.size(), x0);
+
+	QIODevice *device = xmlOutput.device();
+
+	if (device == NULL) return xmlWritePng(xmlOutput, encodePng(image, compression));
+
+	qint64 start = device->pos();
+	if (device->write(" xlink:href=\"data:image/png;base64,") < 0) return false;
+
+	Base64Device base64(device);
+	base64.open(QIODevice::WriteOnly);
+	bool ok = PngWriter::save(image, &base64, compression);
+	base64.close();
+
+	if (device->write("\"") < 0) return false;
+	if (!device->isSequential()) span.setBytes(device->pos() - start);
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+/* Start an image element, without the image data. */
+void SvgWriter::xmlWriteImageStart(QXmlStreamWriter& xmlOutput, const QSize& size, unsigned int x0)
+{
+	xmlOutput.writeStartElement("image");
+	xmlOutput.writeAttribute("id", "barMask");
+	xmlOutput.writeAttribute("width", QString::number(size.width()));
+	xmlOutput.writeAttribute("height", QString::number(size.height()));
+	xmlOutput.writeAttribute("x", QString::number(x0));
+	xmlOutput.writeAttribute("y", QString::number(0));
+}
+
+//----------------------------------------------------------------------
+
+/* Write an encoded PNG file as xlink:href of the open image element. An
+ * empty png means that encoding has failed.
+ */
+bool SvgWriter::xmlWritePng(QXmlStreamWriter& xmlOutput, const QByteArray& png)
+{
+	if (png.isEmpty()) return false;
+
+	QIODevice *device = xmlOutput.device();
+
+	if (device == NULL) {
+		xmlOutput.writeAttribute("xlink:href", QString("data:image/png;base64,") + QString(png.toBase64().data()));
+		return true;
+	}
+
+	if (device->write(" xlink:href=\"data:image/png;base64,") < 0) return false;
+
+	Base64Device base64(device);
+	base64.open(QIODevice::WriteOnly);
+	bool ok = (base64.write(png) == png.size());
+	base64.close();
+
+	if (device->write("\"") < 0) return false;
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Encode an image as PNG file in memory
+ *
+ * \return The PNG file, empty if encoding failed.
+ */
+QByteArray SvgWriter::encodePng(const QImage& image, PngWriter::Compression compression)
+{
+	TraceSpan span("encodePng");
+
+	QByteArray byteArray;
+	QBuffer buffer(&byteArray);
+	buffer.open(QIODevice::WriteOnly);
+	if (!PngWriter::save(image, &buffer, compression)) return QByteArray();
+	buffer.close();
+
+	span.setBytes(byteArray.size());
+
+	return byteArray;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write animation element.
+ *
+ * We do not end the element, so the caller must call
+ *      xmlOutput.writeEndElement();
+ * sooner or later.
+ *
+ * \param xmlOutput
+ * \param image
+ * \param nrFrames
+ *
+ * \return
+ */
+bool SvgWriter::xmlWriteAnimation(
+	QXmlStreamWriter& xmlOutput,
+	int delta,
+	unsigned int nrFrames,
+	double duration)
+{
+	xmlOutput.writeStartElement("animateMotion");
+	xmlOutput.writeAttribute("dur", QString("%1s").arg(duration));
+	xmlOutput.writeAttribute("calcMode", "discrete");
+	xmlOutput.writeAttribute("repeatCount", "indefinite");
+	QString values, keyTimes;
+	for (unsigned int i=0; i<nrFrames; i++) {
+		values += QString("%1,0;").arg((-1) * ((int) i) * delta);
+		keyTimes += QString("%1;").arg(((float) i) / (nrFrames));
+	}
+	xmlOutput.writeAttribute("values", values);
+	xmlOutput.writeAttribute("keyTimes", keyTimes);
+
+	return true;
+}
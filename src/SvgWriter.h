@@ -0,0 +1,66 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SVGWRITER_H
+#define _SVGWRITER_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+#include <QIODevice>
+#include <QXmlStreamWriter>
+
+#include "PngWriter.h"
+
+/*! \brief Writes animations to animated SVG files
+ *
+ * See:
+ *  http://www.w3.org/TR/SVG/animate.html#CalcModeAttribute
+ *  http://qt-project.org/doc/qt-4.8/qxmlstreamwriter.html
+ */
+class SvgWriter
+{
+public:
+	/*! How to write the file */
+	enum Style {
+		/*! Indented, with the bar mask as an embedded image */
+		Formatted,
+		/*! Without whitespace, with the bar mask as a stripe pattern */
+		Compact
+	};
+
+	/* documented in source code */
+	static bool saveAnimation(QIODevice*, const std::vector< QImage* >&, const QImage&, unsigned int, double, Style = Formatted, PngWriter::Compression = PngWriter::Default);
+	static bool exportAnimation(QIODevice*, const QImage&, const QImage&, unsigned int, unsigned int, double, Style = Formatted, PngWriter::Compression = PngWriter::Default);
+
+	static bool xmlWriteImage(QXmlStreamWriter&, const QImage&, unsigned int, PngWriter::Compression = PngWriter::Default);
+	static bool xmlWriteAnimation(QXmlStreamWriter&, int, unsigned int, double);
+
+	static QByteArray encodePng(const QImage&, PngWriter::Compression = PngWriter::Default);
+
+private:
+	static void xmlWriteHeader(QXmlStreamWriter&, const QSize&);
+	static bool xmlWriteBarMask(QXmlStreamWriter&, const QImage&, PngWriter::Compression);
+	static void xmlWriteBarPattern(QXmlStreamWriter&, const QImage&, unsigned int, unsigned int);
+	static void xmlWriteImageStart(QXmlStreamWriter&, const QSize&, unsigned int);
+	static bool xmlWritePng(QXmlStreamWriter&, const QByteArray&);
+};
+
+#endif // _SVGWRITER_H
@@ -0,0 +1,252 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <QBuffer>
+#include <QThreadPool>
+#include <QXmlStreamReader>
+
+#include "BarMask.h"
+#include "SvgReader.h"
+#include "SvgWriter.h"
+#include "Tests.h"
+
+static const char* xlinkNamespace = "http://www.w3.org/1999/xlink";
+
+//----------------------------------------------------------------------
+
+/* An opaque image of noise, its PNG file is larger than the output buffer
+ * of Base64Device.
+ */
+static QImage noiseImage(const QSize& size, unsigned int seed)
+{
+	QImage img(size, QImage::Format_ARGB32);
+	for ( int row=0 ; row<size.height() ; row++ )
+		for ( int col=0 ; col<size.width() ; col++ ) {
+			seed = seed * 1103515245 + 12345;
+			img.setPixel(col, row, qRgb(seed >> 8, seed >> 16, seed >> 24));
+		}
+
+	return img;
+}
+
+//----------------------------------------------------------------------
+
+/* True, if both images have the same size and pixels. */
+static bool samePixels(const QImage& a, const QImage& b)
+{
+	if (a.size() != b.size()) return false;
+
+	QImage a32 = a.convertToFormat(QImage::Format_ARGB32);
+	QImage b32 = b.convertToFormat(QImage::Format_ARGB32);
+	for ( int row=0 ; row<a32.height() ; row++ )
+		for ( int col=0 ; col<a32.width() ; col++ )
+			if (a32.pixel(col, row) != b32.pixel(col, row)) return false;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/* Parse svg with QXmlStreamReader and decode the images embedded in it,
+ * in the order of the file. False, if the file is not well-formed or an
+ * image is no PNG data URI.
+ */
+static bool readImages(const QByteArray& svg, QList< QImage >& images)
+{
+	static const QString prefix("data:image/png;base64,");
+
+	QXmlStreamReader xml(svg);
+	while (!xml.atEnd()) {
+		xml.readNext();
+		if (!xml.isStartElement() || xml.name() != "image") continue;
+
+		QString href = xml.attributes().value(xlinkNamespace, "href").toString();
+		if (!href.startsWith(prefix)) return false;
+
+		QImage img = QImage::fromData(QByteArray::fromBase64(href.mid(prefix.length()).toLatin1()));
+		if (img.isNull()) return false;
+		images.append(img);
+	}
+
+	return !xml.hasError();
+}
+
+//----------------------------------------------------------------------
+
+/* True, if img is a bar mask of nrFrames frames and strips of stripWidth
+ * pixels. The transparent color that SvgWriter gives index 1 does not
+ * matter. With a single frame, there are no strips to check.
+ */
+static bool isBarMask(QImage img, const QSize& size, unsigned int stripWidth, unsigned int nrFrames)
+{
+	if (img.size() != size) return false;
+	if (nrFrames < 2) return true;
+
+	if (img.format() != QImage::Format_Mono) img = img.convertToFormat(QImage::Format_Mono);
+
+	unsigned int maskFrames, maskStripWidth;
+	if (BarMask::decode(img, maskFrames, maskStripWidth) != BarMask::NoError) return false;
+
+	return maskFrames == nrFrames && maskStripWidth == stripWidth;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write animations with SvgWriter and read them back
+ *
+ * Saved animations of one and several frames, in both styles, and an
+ * exported animation are parsed with QXmlStreamReader. The embedded
+ * images, which xmlWriteImage() streams through Base64Device, must decode
+ * to the written ones. Saved animations must also load with SvgReader,
+ * with their strip width.
+ */
+int Tests::svgRoundTrip()
+{
+	static const SvgWriter::Style styles[] = {SvgWriter::Formatted, SvgWriter::Compact};
+	static const char* styleNames[] = {"formatted", "compact"};
+	static const unsigned int frameCounts[] = {1, 3};
+	const QSize size(67, 29);
+	const unsigned int stripWidth = 3;
+
+	int failures = 0;
+
+	for ( unsigned int f=0 ; f<sizeof(frameCounts) / sizeof(frameCounts[0]) ; f++ ) {
+		unsigned int nrFrames = frameCounts[f];
+
+		std::vector< QImage > frameImages;
+		std::vector< QImage* > frames;
+		for ( unsigned int i=0 ; i<nrFrames ; i++ ) frameImages.push_back(noiseImage(size, i + 1));
+		for ( unsigned int i=0 ; i<nrFrames ; i++ ) frames.push_back(&frameImages[i]);
+
+		QImage barMask;
+		BarMask::create(barMask, size, stripWidth, nrFrames);
+
+		for ( unsigned int s=0 ; s<sizeof(styles) / sizeof(styles[0]) ; s++ ) {
+			QBuffer buffer;
+			buffer.open(QIODevice::WriteOnly);
+			bool ok = SvgWriter::saveAnimation(&buffer, frames, barMask, stripWidth, nrFrames, styles[s]);
+			buffer.close();
+
+			/* the frames, followed by the bar mask if it is an image */
+			QList< QImage > images;
+			ok = ok && readImages(buffer.data(), images);
+			ok = ok && images.size() == (int) nrFrames + ((styles[s] == SvgWriter::Formatted) ? 1 : 0);
+			for ( unsigned int i=0 ; ok && i<nrFrames ; i++ ) ok = samePixels(images[i], frameImages[i]);
+			if (ok && styles[s] == SvgWriter::Formatted)
+				ok = isBarMask(images.last(), size, stripWidth, nrFrames);
+
+			if (!ok) {
+				std::cerr << "The " << styleNames[s] << " animation of " << nrFrames
+					<< " frames does not parse to the written images." << std::endl;
+				failures++;
+			}
+
+			/* the strip width of a one-frame animation is only kept by the
+			 * bar pattern, see SvgReader::read()
+			 */
+			unsigned int expectedStripWidth = (nrFrames > 1 || styles[s] == SvgWriter::Compact) ? stripWidth : 0;
+
+			SvgReader reader;
+			buffer.open(QIODevice::ReadOnly);
+			ok = (reader.read(&buffer) == SvgReader::NoError);
+			ok = ok && reader.frames().size() == (int) nrFrames && reader.stripWidth() == (int) expectedStripWidth;
+			for ( unsigned int i=0 ; ok && i<nrFrames ; i++ ) ok = samePixels(reader.frames()[i].decode(), frameImages[i]);
+
+			if (!ok) {
+				std::cerr << "SvgReader does not read the " << styleNames[s] << " animation of "
+					<< nrFrames << " frames back." << std::endl;
+				failures++;
+			}
+		}
+
+		/* the base image is any image to SvgWriter */
+		QImage baseImage = noiseImage(size, 0);
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		bool ok = SvgWriter::exportAnimation(&buffer, baseImage, barMask, stripWidth, nrFrames, nrFrames);
+		buffer.close();
+
+		QList< QImage > images;
+		ok = ok && readImages(buffer.data(), images);
+		ok = ok && images.size() == 2 && samePixels(images[0], baseImage);
+		ok = ok && isBarMask(images[1], size, stripWidth, nrFrames);
+
+		if (!ok) {
+			std::cerr << "The exported animation of " << nrFrames
+				<< " frames does not parse to the written images." << std::endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Save the same animation on one and on several threads
+ *
+ * The frames are encoded on the global thread pool, but written in order,
+ * so the files must be the same byte for byte.
+ */
+int Tests::svgThreads()
+{
+	static const int threadCounts[] = {1, 2, 3, 8};
+	const QSize size(67, 29);
+	const unsigned int nrFrames = 5;
+	const unsigned int stripWidth = 3;
+
+	std::vector< QImage > frameImages;
+	std::vector< QImage* > frames;
+	for ( unsigned int i=0 ; i<nrFrames ; i++ ) frameImages.push_back(noiseImage(size, i + 1));
+	for ( unsigned int i=0 ; i<nrFrames ; i++ ) frames.push_back(&frameImages[i]);
+
+	QImage barMask;
+	BarMask::create(barMask, size, stripWidth, nrFrames);
+
+	QThreadPool *pool = QThreadPool::globalInstance();
+	int maxThreadCount = pool->maxThreadCount();
+
+	int failures = 0;
+	QByteArray reference;
+
+	for ( unsigned int t=0 ; t<sizeof(threadCounts) / sizeof(threadCounts[0]) ; t++ ) {
+		pool->setMaxThreadCount(threadCounts[t]);
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		bool ok = SvgWriter::saveAnimation(&buffer, frames, barMask, stripWidth, nrFrames);
+		buffer.close();
+
+		if (t == 0) reference = buffer.data();
+
+		if (!ok || buffer.data().isEmpty() || buffer.data() != reference) {
+			std::cerr << "The animation saved on " << threadCounts[t]
+				<< " threads differs from the one saved on a single thread." << std::endl;
+			failures++;
+		}
+	}
+
+	pool->setMaxThreadCount(maxThreadCount);
+
+	return failures;
+}
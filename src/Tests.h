@@ -0,0 +1,47 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TESTS_H
+#define _TESTS_H
+
+/*! \brief Tests of the core algorithms, run by animbar_test
+ *
+ * Every test checks the optimized code against a plain reference or reads
+ * back what it wrote, prints the cases that fail to std::cerr and returns
+ * their number. Run them all with
+ *
+ *	ctest
+ *
+ * in the build directory, or call animbar_test directly.
+ */
+class Tests
+{
+public:
+	/* documented in source code */
+	static int barMask();
+	static int barMaskDecode();
+	static int composerBands();
+	static int composerUpdate();
+	static int composerAlpha();
+	static int base64Device();
+	static int svgRoundTrip();
+	static int svgThreads();
+};
+
+#endif // _TESTS_H
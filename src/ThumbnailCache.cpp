@@ -0,0 +1,160 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QStringList>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include "ThumbnailCache.h"
+
+/* the key of the image size in the PNG files' text chunks */
+static const char* sizeKey = "animbar.size";
+
+//----------------------------------------------------------------------
+
+/*! \brief Create a cache of at most maxBytes bytes in directory
+ *
+ * The directory is created if it does not exist. If that fails, nothing is
+ * found and nothing is inserted. Thumbnails left by earlier sessions are
+ * pruned right away.
+ */
+ThumbnailCache::ThumbnailCache(const QString& directory, qint64 maxBytes) :
+	m_maxBytes(maxBytes)
+{
+	if (QDir().mkpath(directory)) m_directory = directory;
+
+	prune();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Look up the thumbnail of an image file
+ *
+ * \param fileName The image file
+ * \param height Height of the thumbnail
+ * \param size (out) Size of the image, if found
+ *
+ * \return The thumbnail, a null image if there is none for the file as it
+ *  is now.
+ */
+QImage ThumbnailCache::find(const QString& fileName, int height, QSize& size) const
+{
+	QString cached = path(fileName, height);
+	if (cached.isEmpty() || !QFile::exists(cached)) return QImage();
+
+	QImageReader reader(cached, "png");
+	QStringList dimensions = reader.text(sizeKey).split('x');
+	if (dimensions.size() != 2) return QImage();
+
+	QImage thumbnail = reader.read();
+	if (thumbnail.isNull()) return QImage();
+
+	size = QSize(dimensions[0].toInt(), dimensions[1].toInt());
+	if (size.isEmpty()) return QImage();
+
+	/* it is the most recently used one now, see prune() */
+	utime(QFile::encodeName(cached).constData(), NULL);
+
+	return thumbnail;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Add the thumbnail of an image file
+ *
+ * \param fileName The image file
+ * \param height Height of the thumbnail, which may differ from the
+ *  thumbnail's actual height for very small images
+ * \param thumbnail The thumbnail
+ * \param size Size of the image
+ */
+void ThumbnailCache::insert(const QString& fileName, int height, const QImage& thumbnail, const QSize& size) const
+{
+	QString cached = path(fileName, height);
+	if (cached.isEmpty() || thumbnail.isNull()) return;
+
+	/* other threads may write the same thumbnail at the same time */
+	QString temporary = QString("%1.%2.tmp").arg(cached).arg((quintptr) QThread::currentThreadId());
+
+	QImageWriter writer(temporary, "png");
+	writer.setText(sizeKey, QString("%1x%2").arg(size.width()).arg(size.height()));
+	if (!writer.write(thumbnail)) {
+		QFile::remove(temporary);
+		return;
+	}
+
+	QFile::remove(cached);
+	if (!QFile::rename(temporary, cached)) QFile::remove(temporary);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Remove the least recently used thumbnails until the cache fits
+ *
+ * The thumbnails are ordered by their modification time, which insert()
+ * and find() set. This must not run while other threads insert.
+ */
+void ThumbnailCache::prune() const
+{
+	if (m_directory.isEmpty()) return;
+
+	/* most recently used first */
+	QFileInfoList files = QDir(m_directory).entryInfoList(QStringList("*.png"), QDir::Files, QDir::Time);
+
+	qint64 bytes = 0;
+	for ( int i=0 ; i<files.size() ; i++ ) {
+		bytes += files[i].size();
+		if (bytes > m_maxBytes) QFile::remove(files[i].absoluteFilePath());
+	}
+}
+
+//----------------------------------------------------------------------
+
+/* The cache file of an image file, empty if the image file does not exist
+ * or the cache is unusable.
+ */
+QString ThumbnailCache::path(const QString& fileName, int height) const
+{
+	if (m_directory.isEmpty()) return QString();
+
+	QFileInfo info(fileName);
+	if (!info.exists()) return QString();
+
+	QString key = QString("%1\n%2\n%3\n%4")
+		.arg(info.absoluteFilePath())
+		.arg(info.lastModified().toTime_t())
+		.arg(info.size())
+		.arg(height);
+
+	QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5);
+
+	return m_directory + "/" + hash.toHex() + ".png";
+}
@@ -0,0 +1,59 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THUMBNAILCACHE_H
+#define _THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+/*! \brief Keeps the thumbnails of input images on disk
+ *
+ * Every thumbnail is a PNG file in the cache directory, named after a hash
+ * of the image's absolute path, modification time and file size and of
+ * the thumbnail height. An image that has been changed thus gets a new
+ * thumbnail, the old one is not looked up anymore. Along with the
+ * thumbnail we keep the size of the image, so a cached image needs not be
+ * opened at all until its pixels are needed.
+ *
+ * The cache may be used from several threads at once, every file is
+ * written under a temporary name first and then renamed. It is kept below
+ * a number of bytes by prune(), which removes the least recently used
+ * thumbnails first. A thumbnail that is found is marked as used by its
+ * modification time.
+ */
+class ThumbnailCache
+{
+public:
+	/* documented in source code */
+	ThumbnailCache(const QString&, qint64 = 64 * 1024 * 1024);
+
+	QImage find(const QString&, int, QSize&) const;
+	void insert(const QString&, int, const QImage&, const QSize&) const;
+	void prune() const;
+
+private:
+	QString path(const QString&, int) const;
+
+	QString m_directory;
+	qint64 m_maxBytes;
+};
+
+#endif // _THUMBNAILCACHE_H
@@ -0,0 +1,228 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <iostream>
+
+#include "TiffWriter.h"
+#include "Interleaver.h"
+#include "Trace.h"
+
+/* TIFF field types */
+static const quint16 tiffShort = 3;
+static const quint16 tiffLong = 4;
+static const quint16 tiffLong8 = 16;
+
+//----------------------------------------------------------------------
+
+TiffWriter::TiffWriter(QIODevice *device) :
+	m_device(device),
+	m_format(QImage::Format_Invalid),
+	m_bigTiff(false),
+	m_rowBytes(0),
+	m_rowsWritten(0)
+{
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write header and directory of the file
+ *
+ * \param size Size of the image
+ * \param format Interleaver::format, QImage::Format_ARGB32 or
+ *  QImage::Format_Mono
+ * \param rowsPerStrip Number of rows per TIFF strip, e.g. the number of
+ *  rows passed to writeRows() at once
+ *
+ * \return False, if the parameters are invalid or writing failed.
+ */
+bool TiffWriter::begin(const QSize& size, QImage::Format format, int rowsPerStrip)
+{
+	if (size.isEmpty() || rowsPerStrip <= 0) return false;
+	if (format != Interleaver::format && format != QImage::Format_ARGB32 && format != QImage::Format_Mono) {
+		std::cerr << "TiffWriter::begin - Unsupported image format." << std::endl;
+		return false;
+	}
+
+	m_size = size;
+	m_format = format;
+	m_rowsWritten = 0;
+
+	bool rgba = (format != QImage::Format_Mono);
+	m_rowBytes = rgba ? 4 * size.width() : (size.width() + 7) / 8;
+	m_row.resize(m_rowBytes);
+
+	rowsPerStrip = qMin(rowsPerStrip, size.height());
+	quint64 nrStrips = (size.height() + rowsPerStrip - 1) / rowsPerStrip;
+	quint64 stripBytes = (quint64) m_rowBytes * rowsPerStrip;
+	quint64 dataBytes = (quint64) m_rowBytes * size.height();
+
+	quint16 nrEntries = rgba ? 11 : 10;
+
+	/* We try a classic TIFF file first and switch to BigTIFF if the pixels
+	 * would end beyond 4 GB. The layout is
+	 *  header | directory | bits per sample | strip offsets |
+	 *  strip byte counts | pixels
+	 * where the arrays are only there if they don't fit into an entry.
+	 */
+	quint64 headerSize, valueSize, offsetSize, dirEnd;
+	quint64 bitsPos, offsetsPos, countsPos, dataPos;
+	for ( int big=0 ; big<2 ; big++ ) {
+		m_bigTiff = (big == 1);
+		headerSize = m_bigTiff ? 16 : 8;
+		valueSize = m_bigTiff ? 8 : 4;
+		offsetSize = m_bigTiff ? 8 : 4;
+		dirEnd = headerSize + (m_bigTiff ? 8 + 20 * nrEntries + 8 : 2 + 12 * nrEntries + 4);
+
+		bitsPos = dirEnd;
+		offsetsPos = bitsPos + ((rgba && 4 * 2 > valueSize) ? 4 * 2 : 0);
+		countsPos = offsetsPos + ((nrStrips * offsetSize > valueSize) ? nrStrips * offsetSize : 0);
+		dataPos = countsPos + ((nrStrips * offsetSize > valueSize) ? nrStrips * offsetSize : 0);
+
+		if (m_bigTiff || dataPos + dataBytes <= Q_UINT64_C(0xffffffff)) break;
+	}
+
+	quint16 offsetType = m_bigTiff ? tiffLong8 : tiffLong;
+
+	QByteArray head;
+
+	/* header, little endian */
+	head.append("II");
+	if (m_bigTiff) {
+		putInt(head, 43, 2);
+		putInt(head, 8, 2);
+		putInt(head, 0, 2);
+		putInt(head, headerSize, 8);
+	} else {
+		putInt(head, 42, 2);
+		putInt(head, headerSize, 4);
+	}
+
+	/* the directory, sorted by tag */
+	putInt(head, nrEntries, m_bigTiff ? 8 : 2);
+	putEntry(head, 256, tiffLong, 1, size.width());                  // ImageWidth
+	putEntry(head, 257, tiffLong, 1, size.height());                 // ImageLength
+	if (rgba) {
+		/* four times 8, inline for BigTIFF */
+		if (m_bigTiff) putEntry(head, 258, tiffShort, 4, Q_UINT64_C(0x0008000800080008));
+		else putEntry(head, 258, tiffShort, 4, bitsPos);
+	} else putEntry(head, 258, tiffShort, 1, 1);                      // BitsPerSample
+	putEntry(head, 259, tiffShort, 1, 1);                            // Compression: none
+	putEntry(head, 262, tiffShort, 1, rgba ? 2 : 1);                 // Photometric: RGB, BlackIsZero
+	putEntry(head, 273, offsetType, nrStrips, (nrStrips * offsetSize > valueSize) ? offsetsPos : dataPos);
+	putEntry(head, 277, tiffShort, 1, rgba ? 4 : 1);                 // SamplesPerPixel
+	putEntry(head, 278, tiffLong, 1, rowsPerStrip);                  // RowsPerStrip
+	putEntry(head, 279, offsetType, nrStrips, (nrStrips * offsetSize > valueSize) ? countsPos : dataBytes);
+	putEntry(head, 284, tiffShort, 1, 1);                            // PlanarConfiguration: chunky
+	if (rgba) {
+		/* ExtraSamples: associated (premultiplied) or unassociated alpha */
+		putEntry(head, 338, tiffShort, 1, (format == Interleaver::format) ? 1 : 2);
+	}
+	putInt(head, 0, offsetSize);                                     // no next directory
+
+	if (rgba && !m_bigTiff) for ( int i=0 ; i<4 ; i++ ) putInt(head, 8, 2);
+
+	if (nrStrips * offsetSize > valueSize) {
+		for ( quint64 i=0 ; i<nrStrips ; i++ ) putInt(head, dataPos + i * stripBytes, offsetSize);
+		for ( quint64 i=0 ; i<nrStrips ; i++ ) putInt(head, qMin(stripBytes, dataBytes - i * stripBytes), offsetSize);
+	}
+
+	return m_device->write(head) == head.size();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Write the next rows of the image
+ *
+ * \param bits The first row to write, in the format passed to begin()
+ * \param bytesPerLine Bytes from one row to the next. Zero writes the same
+ *  row nrRows times, as needed for a bar mask.
+ * \param nrRows Number of rows
+ *
+ * \return False, if there are more rows than the image has or writing
+ *  failed.
+ */
+bool TiffWriter::writeRows(const unsigned char* bits, int bytesPerLine, int nrRows)
+{
+	if (m_rowsWritten + nrRows > m_size.height()) return false;
+
+	TraceSpan span("writeRows");
+
+	for ( int row=0 ; row<nrRows ; row++ ) {
+		const unsigned char *line = bits + (size_t) row * bytesPerLine;
+
+		if (m_format == QImage::Format_Mono) {
+			if (m_device->write((const char*) line, m_rowBytes) != m_rowBytes) return false;
+		} else {
+			/* QImage stores 0xAARRGGBB words, TIFF wants R, G, B, A */
+			const quint32 *src = (const quint32*) line;
+			unsigned char *dst = &m_row[0];
+			for ( int x=0 ; x<m_size.width() ; x++ ) {
+				quint32 p = src[x];
+				dst[0] = (p >> 16) & 0xff;
+				dst[1] = (p >> 8) & 0xff;
+				dst[2] = p & 0xff;
+				dst[3] = p >> 24;
+				dst += 4;
+			}
+			if (m_device->write((const char*) &m_row[0], m_rowBytes) != m_rowBytes) return false;
+		}
+	}
+
+	m_rowsWritten += nrRows;
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Finish the file
+ *
+ * \return False, if not all rows have been written.
+ */
+bool TiffWriter::end()
+{
+	if (m_rowsWritten != m_size.height()) {
+		std::cerr << "TiffWriter::end - Image incomplete." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/* Append value as little endian integer of size bytes. */
+void TiffWriter::putInt(QByteArray& data, quint64 value, int size) const
+{
+	for ( int i=0 ; i<size ; i++ ) data.append((char) ((value >> (8 * i)) & 0xff));
+}
+
+//----------------------------------------------------------------------
+
+/* Append a directory entry. Values that fit into the entry are stored left
+ * justified, which is what putInt() does for little endian files.
+ */
+void TiffWriter::putEntry(QByteArray& data, quint16 tag, quint16 type, quint64 count, quint64 value) const
+{
+	putInt(data, tag, 2);
+	putInt(data, type, 2);
+	putInt(data, count, m_bigTiff ? 8 : 4);
+	putInt(data, value, m_bigTiff ? 8 : 4);
+}
@@ -0,0 +1,73 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TIFFWRITER_H
+#define _TIFFWRITER_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+#include <QIODevice>
+
+/*! \brief Writes uncompressed TIFF files row by row
+ *
+ * Qt's image writers need the complete image in memory. This writer takes
+ * the rows in order, a few at a time, and writes them right away, so an
+ * image may be written while it is being computed. As the file is not
+ * compressed, all offsets are known in advance: we write the header and
+ * the directory first and the pixels in one sequential pass after it, no
+ * seeking is needed.
+ *
+ * Supported are images in Interleaver::format, written as 8 bit RGBA with
+ * associated (premultiplied) alpha, in QImage::Format_ARGB32, written as
+ * 8 bit RGBA with unassociated alpha, and QImage::Format_Mono, written as
+ * bilevel image. Files of 4 GB and more are written as BigTIFF.
+ *
+ * See:
+ *  http://partners.adobe.com/public/developer/en/tiff/TIFF6.pdf
+ *  http://www.awaresystems.be/imaging/tiff/bigtiff.html
+ */
+class TiffWriter
+{
+public:
+	TiffWriter(QIODevice *device);
+
+	/* documented in source code */
+	bool begin(const QSize&, QImage::Format, int);
+	bool writeRows(const unsigned char*, int, int);
+	bool end();
+
+	bool isBigTiff() const { return m_bigTiff; }
+
+private:
+	void putInt(QByteArray&, quint64, int) const;
+	void putEntry(QByteArray&, quint16, quint16, quint64, quint64) const;
+
+	QIODevice *m_device;
+	QSize m_size;
+	QImage::Format m_format;
+	bool m_bigTiff;
+
+	int m_rowBytes;
+	int m_rowsWritten;
+	std::vector< unsigned char > m_row;
+};
+
+#endif // _TIFFWRITER_H
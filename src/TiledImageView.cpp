@@ -0,0 +1,150 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QPainter>
+#include <QPaintEvent>
+
+#include "TiledImageView.h"
+
+//----------------------------------------------------------------------
+
+TiledImageView::TiledImageView(QWidget *parent) :
+	QWidget(parent),
+	m_frame(0),
+	m_zoom(1.)
+{
+	/* 64 MB of tiles */
+	m_tiles.setMaxCost(64 * 1024);
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the image to display
+ *
+ * \param image The image, kept as shallow copy
+ * \param frame Identifies the image in the tile cache. Images passed with
+ *  the same frame must be the same until clearCache() is called.
+ */
+void TiledImageView::setImage(const QImage& image, int frame)
+{
+	m_image = image;
+	m_frame = frame;
+
+	resize(zoomedSize());
+	update();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Set the zoom factor, 1 displays the image pixel by pixel */
+void TiledImageView::setZoom(double zoom)
+{
+	m_zoom = zoom;
+
+	resize(zoomedSize());
+	update();
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Drop all cached tiles, e.g. when the displayed frames change */
+void TiledImageView::clearCache()
+{
+	m_tiles.clear();
+}
+
+//----------------------------------------------------------------------
+
+QSize TiledImageView::sizeHint() const
+{
+	return zoomedSize();
+}
+
+//----------------------------------------------------------------------
+
+QSize TiledImageView::zoomedSize() const
+{
+	if (m_image.isNull()) return QSize(0, 0);
+
+	/* no rounding, as QPixmap::scaled() did before */
+	return QSize((int) (m_zoom * m_image.width()), (int) (m_zoom * m_image.height()));
+}
+
+//----------------------------------------------------------------------
+
+void TiledImageView::paintEvent(QPaintEvent *event)
+{
+	if (m_image.isNull()) return;
+
+	QRect exposed = event->rect() & QRect(QPoint(0, 0), zoomedSize());
+	if (exposed.isEmpty()) return;
+
+	QPainter painter(this);
+	int zoomKey = qRound(m_zoom * 65536);
+
+	for ( int ty=exposed.top()/tileSize ; ty<=exposed.bottom()/tileSize ; ty++ )
+		for ( int tx=exposed.left()/tileSize ; tx<=exposed.right()/tileSize ; tx++ ) {
+			TileKey key(m_frame, zoomKey, tx, ty);
+
+			/* QCache::insert() may delete the tile right away if it
+			 * does not fit, so we draw our own copy.
+			 */
+			QPixmap tile;
+			QPixmap *cached = m_tiles.object(key);
+			if (cached) tile = *cached;
+			else {
+				tile = renderTile(tx, ty);
+				int cost = qMax(tile.width() * tile.height() * 4 / 1024, 1);
+				m_tiles.insert(key, new QPixmap(tile), cost);
+			}
+
+			painter.drawPixmap(tx * tileSize, ty * tileSize, tile);
+		}
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Scale a single tile from the image
+ *
+ * The painter maps the image with the same transformation for all tiles,
+ * only translated by the tile's position, so the tiles fit together
+ * seamlessly. No smoothing, as we want to see the pixels.
+ */
+QPixmap TiledImageView::renderTile(int tx, int ty) const
+{
+	QRect tileRect = QRect(tx * tileSize, ty * tileSize, tileSize, tileSize) &
+		QRect(QPoint(0, 0), zoomedSize());
+
+	QPixmap tile(tileRect.size());
+	tile.fill(Qt::transparent);
+
+	QRect source = QRectF(
+		tileRect.x() / m_zoom,
+		tileRect.y() / m_zoom,
+		tileRect.width() / m_zoom,
+		tileRect.height() / m_zoom).toAlignedRect() & m_image.rect();
+
+	QPainter painter(&tile);
+	painter.translate(-tileRect.x(), -tileRect.y());
+	painter.scale(m_zoom, m_zoom);
+	painter.drawImage(source.topLeft(), m_image, source);
+	painter.end();
+
+	return tile;
+}
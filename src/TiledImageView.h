@@ -0,0 +1,95 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TILEDIMAGEVIEW_H
+#define _TILEDIMAGEVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QPixmap>
+#include <QCache>
+
+/*! \brief Identifies a tile of TiledImageView's cache */
+struct TileKey
+{
+	TileKey(int frame_, int zoom_, int x_, int y_) :
+		frame(frame_), zoom(zoom_), x(x_), y(y_) {}
+
+	bool operator==(const TileKey& other) const
+	{
+		return frame == other.frame && zoom == other.zoom &&
+			x == other.x && y == other.y;
+	}
+
+	int frame;
+	/* zoom factor in 1/65536 */
+	int zoom;
+	/* tile column and row */
+	int x;
+	int y;
+};
+
+inline uint qHash(const TileKey& key)
+{
+	return ((uint) key.frame * 31u + (uint) key.zoom) * 961u +
+		(uint) key.x * 31u + (uint) key.y;
+}
+
+/*! \brief Displays a zoomed image, one tile at a time
+ *
+ * The widget is as large as the zoomed image and is meant to be put into a
+ * QScrollArea. When painting, only the tiles inside the exposed area are
+ * scaled from the image and converted to pixmaps. Tiles are kept in a
+ * least recently used cache of bounded size, keyed by frame, zoom factor
+ * and tile position, so switching between frames and zoom levels already
+ * seen only draws cached pixmaps.
+ */
+class TiledImageView : public QWidget
+{
+	Q_OBJECT
+
+public:
+	TiledImageView(QWidget *parent = NULL);
+
+	/* documented in source code */
+	void setImage(const QImage&, int);
+	void setZoom(double);
+	void clearCache();
+
+	QSize sizeHint() const;
+
+	/*! Edge length of the tiles in pixels */
+	static const int tileSize = 256;
+
+protected:
+	void paintEvent(QPaintEvent*);
+
+private:
+	QPixmap renderTile(int, int) const;
+	QSize zoomedSize() const;
+
+	QImage m_image;
+	int m_frame;
+	double m_zoom;
+
+	/* cost in kilobytes */
+	QCache< TileKey, QPixmap > m_tiles;
+};
+
+#endif // _TILEDIMAGEVIEW_H
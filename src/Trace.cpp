@@ -0,0 +1,153 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+#include "Trace.h"
+
+/* A recorded span, times in microseconds since start(). */
+struct TraceEvent
+{
+	const char *name;
+	qint64 start;
+	qint64 duration;
+	qint64 bytes;
+	int thread;
+};
+
+QAtomicInt Trace::s_enabled(0);
+
+/* everything below is only touched while holding traceMutex, except for
+ * traceTimer, which is not changed while tracing.
+ */
+static QMutex traceMutex;
+static QElapsedTimer traceTimer;
+static QString traceFileName;
+static QVector< TraceEvent > traceEvents;
+static QHash< Qt::HANDLE, int > traceThreads;
+
+//----------------------------------------------------------------------
+
+/*! \brief Start tracing
+ *
+ * \param fileName The file stop() writes the trace to
+ *
+ * \return False, if the file can't be written, tracing is off then.
+ */
+bool Trace::start(const QString& fileName)
+{
+	QMutexLocker locker(&traceMutex);
+
+	/* fail early rather than losing the trace at exit */
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) return false;
+	file.close();
+
+	traceFileName = fileName;
+	traceEvents.clear();
+	traceThreads.clear();
+	traceTimer.start();
+
+	/* the timer must be set before other threads see the flag */
+	s_enabled.fetchAndStoreOrdered(1);
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+/*! \brief Stop tracing and write all spans recorded so far
+ *
+ * Spans still open are not written.
+ *
+ * \return False, if tracing was off or the file could not be written.
+ */
+bool Trace::stop()
+{
+	QMutexLocker locker(&traceMutex);
+
+	if (!s_enabled.testAndSetOrdered(1, 0)) return false;
+
+	QFile file(traceFileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+	/* complete events ("ph": "X"), one per line */
+	file.write("{\"traceEvents\": [\n");
+	for ( int i=0 ; i<traceEvents.size() ; i++ ) {
+		const TraceEvent& e = traceEvents[i];
+		QString line = QString("{\"name\": \"%1\", \"ph\": \"X\", \"pid\": 1, \"tid\": %2, \"ts\": %3, \"dur\": %4")
+			.arg(e.name)
+			.arg(e.thread)
+			.arg(e.start)
+			.arg(e.duration);
+		if (e.bytes >= 0) line += QString(", \"args\": {\"bytes\": %1}").arg(e.bytes);
+		line += (i + 1 < traceEvents.size()) ? "},\n" : "}\n";
+		file.write(line.toUtf8());
+	}
+	file.write("],\n\"displayTimeUnit\": \"ms\"}\n");
+
+	traceEvents.clear();
+	traceThreads.clear();
+
+	file.close();
+	return file.error() == QFile::NoError;
+}
+
+//----------------------------------------------------------------------
+
+/* Microseconds since start(). */
+qint64 Trace::now()
+{
+	return traceTimer.nsecsElapsed() / 1000;
+}
+
+//----------------------------------------------------------------------
+
+/* Add a span. Threads are numbered in the order they record their first
+ * span, the GUI or main thread usually is 1.
+ */
+void Trace::record(const char* name, qint64 start, qint64 end, qint64 bytes)
+{
+	QMutexLocker locker(&traceMutex);
+
+	/* stop() may have come in between */
+	if (!isEnabled()) return;
+
+	Qt::HANDLE id = QThread::currentThreadId();
+	QHash< Qt::HANDLE, int >::const_iterator it = traceThreads.constFind(id);
+	int thread = (it != traceThreads.constEnd()) ? it.value() : 0;
+	if (thread == 0) {
+		thread = traceThreads.size() + 1;
+		traceThreads.insert(id, thread);
+	}
+
+	TraceEvent event;
+	event.name = name;
+	event.start = start;
+	event.duration = end - start;
+	event.bytes = bytes;
+	event.thread = thread;
+	traceEvents.append(event);
+}
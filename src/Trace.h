@@ -0,0 +1,93 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+/*! \brief Records spans of work to a trace-event file
+ *
+ * Tracing is off unless start() has been called, which main() does for
+ * --trace FILE or the environment variable ANIMBAR_TRACE=FILE. The spans
+ * are kept in memory and written by stop() as JSON in the trace-event
+ * format, which chrome://tracing and similar viewers load. Spans are
+ * recorded with the thread they ran on, so concurrent work shows up on
+ * several tracks.
+ *
+ * Spans are recorded with TraceSpan. With tracing off, a span costs a
+ * test of one flag.
+ */
+class Trace
+{
+public:
+	/* documented in source code */
+	static bool start(const QString&);
+	static bool stop();
+
+	/*! True between start() and stop() */
+	static bool isEnabled() { return s_enabled != 0; }
+
+private:
+	friend class TraceSpan;
+
+	static qint64 now();
+	static void record(const char*, qint64, qint64, qint64);
+
+	static QAtomicInt s_enabled;
+};
+
+/*! \brief A span of work, from construction to destruction
+ *
+ * For example
+ *
+ *	TraceSpan span("saveImage");
+ *	...
+ *	span.setBytes(file.size());
+ *
+ * The name must outlive the span, usually it is a string literal.
+ */
+class TraceSpan
+{
+public:
+	TraceSpan(const char* name) :
+		m_name(name),
+		m_start(Trace::isEnabled() ? Trace::now() : -1),
+		m_bytes(-1) {}
+
+	~TraceSpan()
+	{
+		if (m_start >= 0) Trace::record(m_name, m_start, Trace::now(), m_bytes);
+	}
+
+	/*! Number of bytes the span read or wrote, shown with the span */
+	void setBytes(qint64 bytes) { m_bytes = bytes; }
+
+private:
+	/* not copyable, a copy would record the span twice */
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+
+	const char *m_name;
+	qint64 m_start;
+	qint64 m_bytes;
+};
+
+#endif // _TRACE_H
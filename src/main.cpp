@@ -17,17 +17,71 @@
  * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <iostream>
+
 #include <QApplication>
+#include <QCoreApplication>
 
 #include "animbar.h"
+#include "Batch.h"
 #include "MainWindow.h"
+#include "Trace.h"
+
+/* Remove --trace FILE from arguments and return FILE, or the value of
+ * ANIMBAR_TRACE if there is no such option.
+ */
+static QString takeTraceFile(QStringList& arguments)
+{
+	QString fileName = QString::fromLocal8Bit(qgetenv("ANIMBAR_TRACE"));
+	
+	int i = arguments.indexOf("--trace");
+	if (i > 0 && i + 1 < arguments.size()) {
+		fileName = arguments[i+1];
+		arguments.removeAt(i);
+		arguments.removeAt(i);
+	}
+	
+	return fileName;
+}
 
 int main(int argc, char **argv)
 {
-	QApplication app(argc, argv);
+	/* e.g. for the location of the thumbnail cache */
+	QCoreApplication::setOrganizationName("mnim.org");
+	QCoreApplication::setApplicationName(ANIMBAR_PROG_NAME);
+	
+	/* with options on the command line, we run in batch mode without any
+	 * window, so we do not need (and may not have) a display.
+	 */
+	QStringList arguments;
+	for ( int i=0 ; i<argc ; i++ ) arguments << QString::fromLocal8Bit(argv[i]);
+	
+	/* tracing does not make a batch run */
+	QString traceFile = takeTraceFile(arguments);
+	if (!traceFile.isEmpty() && !Trace::start(traceFile))
+		std::cerr << "Could not write trace to " << traceFile.toLocal8Bit().constData() << std::endl;
+	
+	int result;
+	
+	if (Batch::isBatch(arguments)) {
+		QCoreApplication app(argc, argv);
+		
+		QStringList appArguments = app.arguments();
+		takeTraceFile(appArguments);
+		
+		Batch batch;
+		result = batch.run(appArguments);
+	} else {
+		QApplication app(argc, argv);
+		
+		MainWindow mainWindow;
+		mainWindow.show();
+		
+		result = app.exec();
+	}
 	
-	MainWindow mainWindow;
-	mainWindow.show();
+	if (Trace::isEnabled() && !Trace::stop())
+		std::cerr << "Could not write trace to " << traceFile.toLocal8Bit().constData() << std::endl;
 	
-	return app.exec();
+	return result;
 }
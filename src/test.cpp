@@ -0,0 +1,48 @@
+/*
+ * (c) 2010 Simon Flöry (simon.floery@gmx.at)
+ *
+ * This file is part of animbar.
+ *
+ * animbar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * animbar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with animbar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include <QApplication>
+
+#include "Tests.h"
+
+int main(int argc, char **argv)
+{
+	/* images want an application object, but we need no display */
+	QApplication app(argc, argv, false);
+	
+	int failures = 0;
+	failures += Tests::barMask();
+	failures += Tests::barMaskDecode();
+	failures += Tests::composerBands();
+	failures += Tests::composerUpdate();
+	failures += Tests::composerAlpha();
+	failures += Tests::base64Device();
+	failures += Tests::svgRoundTrip();
+	failures += Tests::svgThreads();
+	
+	if (failures > 0) {
+		std::cerr << failures << " test cases failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "All tests passed." << std::endl;
+	return 0;
+}